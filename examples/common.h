@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "GLFW/glfw3.h"
+#include "paintbox.h"
 
 static GLFWwindow* window;
 
@@ -35,16 +36,23 @@ int main() {
 	centralize_window(window);
 	glfwMakeContextCurrent(window);
 	
+	// Set PAINTBOX_CAPTURE to a file path to record a trace of the whole run. Play it back with example_replay.
+	const char* capture_path = getenv("PAINTBOX_CAPTURE");
+	if (capture_path) Paintbox::capture_begin(capture_path);
+	
 	init();
 	
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 		
 		do_frame();
+		if (capture_path) Paintbox::capture_frame_end();
 		
 		glfwSwapBuffers(window);
 	}
 	
+	if (capture_path) Paintbox::capture_end();
+	
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	
@@ -0,0 +1,107 @@
+#define EXAMPLE_NAME "Cloth"
+#include "common.h"
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+#include <math.h>
+
+// A wall of flags, 64 by 64 particles each, hanging from their top corners and swaying in gusts of wind.
+// Every flag is its own cloth, and cloth_step spreads them over the job threads. Hold the left mouse button for a storm.
+// The window title shows how long the steps take.
+
+constexpr int32_t flag_columns = 16;
+constexpr int32_t flag_rows = 12;
+constexpr int32_t flag_count = flag_columns * flag_rows;
+constexpr int32_t flag_resolution = 64;
+constexpr float flag_spacing = 0.02f;
+constexpr float flag_distance = 1.6f;
+
+Cloth* flags[flag_count];
+Shader* flag_pixel_shader;
+
+// Stripes make the folds show, since nothing else in the pixel shader knows which way the cloth faces.
+static const char* glsl_flag_pixel_shader_source = R"glsl(
+#version 410
+
+in vec4 pixel_color;
+in vec2 pixel_uv;
+out vec4 result_color;
+
+void main() {
+	float stripe = step(0.5, fract(pixel_uv.x * 6.0));
+	result_color = vec4(pixel_color.rgb * (0.7 + 0.3 * stripe), 1);
+}
+
+)glsl";
+
+bool init() {
+	Paintbox::initialize();
+	
+	flag_pixel_shader = shader_create(ShaderLanguage::GLSL, ShaderType::PIXEL, glsl_flag_pixel_shader_source);
+	
+	float flag_size = (flag_resolution - 1) * flag_spacing;
+	for (int32_t i = 0; i < flag_count; i += 1) {
+		float column = (float) (i % flag_columns);
+		float row = (float) (i / flag_columns);
+		
+		vec3 top_left;
+		top_left.x = (column - (flag_columns - 1) * 0.5f) * flag_distance - flag_size * 0.5f;
+		top_left.y = ((flag_rows - 1) * 0.5f - row) * flag_distance + flag_size * 0.5f;
+		top_left.z = 0;
+		
+		vec4 color = vec4(0.4f + 0.6f * column / flag_columns, 0.5f, 0.4f + 0.6f * row / flag_rows, 1);
+		
+		Cloth* flag = cloth_create(flag_resolution, flag_resolution, top_left, flag_spacing, color);
+		cloth_pin(flag, 0, 0);
+		cloth_pin(flag, flag_resolution - 1, 0);
+		flags[i] = flag;
+	}
+	
+	return true;
+}
+
+void do_frame() {
+	int window_width, window_height;
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+	if (window_width == 0 || window_height == 0) return; // Minimized. Nobody sees the flags, and the aspect ratio would divide by zero.
+	
+	// Gusts roll across the wall from left to right.
+	float time = (float) glfwGetTime();
+	float strength = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) ? 12.0f : 3.0f;
+	for (int32_t i = 0; i < flag_count; i += 1) {
+		float column = (float) (i % flag_columns);
+		float gust = sinf(time * 1.3f - column * 0.4f) + 0.5f * sinf(time * 3.1f + i);
+		flags[i]->acceleration = vec3(strength * gust, -9.8f, 0);
+	}
+	
+	double step_start = glfwGetTime();
+	cloth_step(flags, flag_count, 1.0f / 60);
+	double step_seconds = glfwGetTime() - step_start;
+	
+	static double total_step_seconds = 0;
+	static int32_t frame_count = 0;
+	total_step_seconds += step_seconds;
+	frame_count += 1;
+	if (frame_count == 120) {
+		char title[128];
+		snprintf(title, sizeof(title), EXAMPLE_NAME " - %.3f ms per step for %d flags, on %d threads", total_step_seconds / frame_count * 1000, flag_count, job_thread_count());
+		glfwSetWindowTitle(window, title);
+		
+		total_step_seconds = 0;
+		frame_count = 0;
+	}
+	
+	canvas_clear(nullptr, vec4(0.1f, 0.1f, 0.12f, 1));
+	
+	RenderState state;
+	state.viewport.w = window_width;
+	state.viewport.h = window_height;
+	state.pixel_shader = flag_pixel_shader;
+	
+	float half_height = flag_rows * flag_distance * 0.5f + 0.5f;
+	float half_width = half_height * window_width / window_height;
+	state.projection = orthographic(-half_width, half_width, half_height, -half_height, -10, +10);
+	
+	for (int32_t i = 0; i < flag_count; i += 1) mesh_render(flags[i]->mesh, &state);
+}
\ No newline at end of file
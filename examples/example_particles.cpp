@@ -0,0 +1,120 @@
+#define EXAMPLE_NAME "Particles"
+#include "common.h"
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+// A fountain of a quarter million particles. A compute shader writes their quads straight into a vertex buffer every frame,
+// and the mesh draws from that buffer, so the CPU never touches a particle.
+
+constexpr uint32_t particle_count = 256 * 1024;
+constexpr uint32_t particles_per_group = 256; // Has to match local_size_x in the compute shader.
+
+Shader* particle_compute_shader;
+Buffer* vertex_buffer;
+Buffer* index_buffer;
+Mesh* mesh;
+
+// Every particle is launched from the same spot with a velocity of its own, and restarts when its lifetime is up.
+// Its position follows from the time alone, so there is no particle state to keep between frames.
+static const char* glsl_particle_compute_shader_source = R"glsl(
+#version 430
+
+layout (local_size_x = 256) in;
+
+// Vertex is 9 tightly packed floats, which a vec3 or vec4 member would pad in std430.
+layout (std430, binding = 0) writeonly buffer Vertices {
+	float vertices[];
+};
+
+uniform float time;
+
+const float lifetime = 3.0;
+const float size = 0.02;
+
+float hash(uint x) {
+	x ^= x >> 16; x *= 0x7FEB352Du;
+	x ^= x >> 15; x *= 0x846CA68Bu;
+	x ^= x >> 16;
+	return float(x) / 4294967295.0;
+}
+
+void write_vertex(uint index, vec2 position, vec4 color) {
+	uint base = index * 9u;
+	vertices[base + 0] = position.x;
+	vertices[base + 1] = position.y;
+	vertices[base + 2] = 0.0;
+	vertices[base + 3] = color.r;
+	vertices[base + 4] = color.g;
+	vertices[base + 5] = color.b;
+	vertices[base + 6] = color.a;
+	vertices[base + 7] = 0.0;
+	vertices[base + 8] = 0.0;
+}
+
+void main() {
+	uint particle = gl_GlobalInvocationID.x;
+
+	float spread = hash(particle * 3u + 0u) - 0.5;
+	float speed = hash(particle * 3u + 1u);
+	float age = mod(time + lifetime * hash(particle * 3u + 2u), lifetime);
+
+	vec2 velocity = vec2(2.0 * spread, 5.5 + 1.5 * speed);
+	vec2 position = vec2(0, -3) + velocity * age + vec2(0, -4.9) * age * age;
+
+	float fade = 1.0 - age / lifetime;
+	vec4 color = vec4(mix(vec3(0.2, 0.4, 1.0), vec3(0.8, 0.95, 1.0), fade), 1);
+
+	write_vertex(particle * 4u + 0u, position + vec2(-size, -size), color);
+	write_vertex(particle * 4u + 1u, position + vec2(+size, -size), color);
+	write_vertex(particle * 4u + 2u, position + vec2(+size, +size), color);
+	write_vertex(particle * 4u + 3u, position + vec2(-size, +size), color);
+}
+
+)glsl";
+
+bool init() {
+	Paintbox::initialize();
+	
+	particle_compute_shader = shader_create(ShaderLanguage::GLSL, ShaderType::COMPUTE, glsl_particle_compute_shader_source);
+	
+	// The compute shader writes every vertex before the first render, so the vertex buffer starts out uninitialized.
+	vertex_buffer = buffer_create(particle_count * 4 * sizeof(Vertex));
+	
+	// The quads never change how they're connected, so the indices are only uploaded once.
+	static uint32_t indices[particle_count * 6];
+	for (uint32_t i = 0; i < particle_count; i += 1) {
+		uint32_t corner = i * 4;
+		uint32_t quad[6] = {corner, corner + 1, corner + 2, corner, corner + 2, corner + 3};
+		for (int32_t j = 0; j < 6; j += 1) indices[i * 6 + j] = quad[j];
+	}
+	index_buffer = buffer_create(sizeof(indices), indices);
+	
+	mesh = mesh_create_from_buffers(vertex_buffer, index_buffer, particle_count * 4, particle_count * 6);
+	return true;
+}
+
+void do_frame() {
+	int window_width, window_height;
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+	if (window_width == 0 || window_height == 0) return; // Minimized. There is nothing to draw into, and the aspect ratio would divide by zero.
+	
+	ComputeState compute_state;
+	compute_state.compute_shader = particle_compute_shader;
+	compute_state.buffers[0] = vertex_buffer;
+	compute_dispatch(&compute_state, particle_count / particles_per_group);
+	
+	memory_barrier(BARRIER_VERTEX_BUFFER);
+	
+	canvas_clear(nullptr, vec4(0.05f, 0.05f, 0.08f, 1));
+	
+	RenderState state;
+	state.viewport.w = window_width;
+	state.viewport.h = window_height;
+	
+	float half_height = 4;
+	float half_width = half_height * window_width / window_height;
+	state.projection = orthographic(-half_width, half_width, half_height, -half_height, -1, +1);
+	
+	mesh_render(mesh, &state);
+}
\ No newline at end of file
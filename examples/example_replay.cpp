@@ -0,0 +1,69 @@
+#define EXAMPLE_NAME "Replay"
+#include "common.h"
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+// Plays back a trace recorded by running any example with PAINTBOX_CAPTURE set, and prints how long every frame took.
+//     PAINTBOX_TRACE        Trace to play. Defaults to trace.ptrc.
+//     PAINTBOX_REPLAY_PACED If set, frames are spread out like they were during the capture, instead of going as fast as possible.
+
+Replay* replay;
+bool paced;
+
+double total_cpu_seconds;
+double total_frame_seconds;
+double worst_frame_seconds;
+
+bool init() {
+	Paintbox::initialize();
+	
+	const char* path = getenv("PAINTBOX_TRACE");
+	if (!path) path = "trace.ptrc";
+	
+	paced = getenv("PAINTBOX_REPLAY_PACED") != nullptr;
+	if (!paced) glfwSwapInterval(0);
+	
+	replay = replay_open(path);
+	if (!replay) {
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+		return false;
+	}
+	
+	printf("Replaying %d frames from '%s'%s.\n", replay->frame_count, path, paced ? " at the recorded pace" : "");
+	printf("frame, calls, recorded ms, cpu ms, frame ms\n");
+	return true;
+}
+
+void do_frame() {
+	if (!replay) return;
+	
+	double frame_start = glfwGetTime();
+	
+	ReplayFrameStats stats;
+	if (!replay_frame(replay, &stats)) {
+		int32_t frame_count = replay->next_frame;
+		if (frame_count > 0) {
+			printf("Average: %.3f ms cpu, %.3f ms per frame. Worst frame: %.3f ms.\n", total_cpu_seconds / frame_count * 1000, total_frame_seconds / frame_count * 1000, worst_frame_seconds * 1000);
+		}
+		
+		replay_close(replay);
+		replay = nullptr;
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
+		return;
+	}
+	
+	// Wait for the GPU, so the frame time covers the whole frame and not just submitting it.
+	gpu_finish();
+	double frame_seconds = glfwGetTime() - frame_start;
+	
+	printf("%d, %u, %.3f, %.3f, %.3f\n", stats.frame_index, stats.call_count, stats.recorded_seconds * 1000, stats.cpu_seconds * 1000, frame_seconds * 1000);
+	
+	total_cpu_seconds += stats.cpu_seconds;
+	total_frame_seconds += frame_seconds;
+	if (frame_seconds > worst_frame_seconds) worst_frame_seconds = frame_seconds;
+	
+	if (paced) {
+		while (glfwGetTime() - frame_start < stats.recorded_seconds) {}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#define EXAMPLE_NAME "Sand"
+#include "common.h"
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+// Left mouse button pours sand, right mouse button pours water, middle mouse button draws stone.
+
+SandWorld* world;
+Mesh* mesh;
+Shader* world_pixel_shader;
+
+static const char* glsl_world_pixel_shader_source = R"glsl(
+#version 410
+
+in vec4 pixel_color;
+in vec2 pixel_uv;
+out vec4 result_color;
+
+uniform sampler2D texture0;
+
+void main() {
+	vec4 cell = texelFetch(texture0, ivec2(pixel_uv * textureSize(texture0, 0)), 0); // Nearest cell, no filtering.
+	vec3 background = vec3(0.08, 0.08, 0.1);
+	result_color = vec4(mix(background, cell.rgb, cell.a), 1);
+}
+
+)glsl";
+
+bool init() {
+	Paintbox::initialize();
+	
+	world_pixel_shader = shader_create(ShaderLanguage::GLSL, ShaderType::PIXEL, glsl_world_pixel_shader_source);
+	
+	world = sand_world_create(1024, 576);
+	for (int32_t x = 0; x < world->width; x += 1) sand_set_cell(world, x, 0, CellType::STONE);
+	
+	Vertex vertices[4] = {
+		{{-1, -1, 0}, {1, 1, 1, 1}, {0, 0}},
+		{{+1, -1, 0}, {1, 1, 1, 1}, {1, 0}},
+		{{+1, +1, 0}, {1, 1, 1, 1}, {1, 1}},
+		{{-1, +1, 0}, {1, 1, 1, 1}, {0, 1}},
+	};
+	
+	uint32_t indices[6] = {
+		0, 1, 2,
+		0, 2, 3,
+	};
+	
+	mesh = mesh_create(4, 6, vertices, indices);
+	return true;
+}
+
+void do_frame() {
+	int window_width, window_height;
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+	
+	double mouse_x, mouse_y;
+	glfwGetCursorPos(window, &mouse_x, &mouse_y);
+	
+	int32_t cell_x = (int32_t) (mouse_x / window_width * world->width);
+	int32_t cell_y = (int32_t) ((1 - mouse_y / window_height) * world->height);
+	
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT))   sand_paint(world, vec2(cell_x, cell_y), 8, CellType::SAND);
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT))  sand_paint(world, vec2(cell_x, cell_y), 8, CellType::WATER);
+	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_MIDDLE)) sand_paint(world, vec2(cell_x, cell_y), 4, CellType::STONE);
+	
+	sand_step(world);
+	sand_upload(world);
+	
+	RenderState state;
+	state.viewport.w = window_width;
+	state.viewport.h = window_height;
+	state.texture0 = world->texture;
+	state.pixel_shader = world_pixel_shader;
+	
+	mesh_render(mesh, &state);
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "paintbox.h"
 using namespace Paintbox;
 
+#include <math.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -22,29 +24,42 @@ Texture* normal_texture;
 
 Shader* surface_pixel_shader;
 
-static const char* glsl_surface_pixel_shader_source = R"glsl(
-#version 410
+constexpr int32_t light_count = 256;
+LightGrid* light_grid;
 
+// Bake these with:
+//     bake_texture Gravel033_1K_Color.jpg Gravel033_1K_Color.ptex bc1
+//     bake_texture Gravel033_1K_NormalGL.jpg Gravel033_1K_NormalGL.ptex bc5 --normal
+// If they are missing, we fall back to decoding the JPEGs, which is a lot slower. The JPEGs have no alpha, so
+// they're decoded as RGB and converted to 'format' on upload.
+static Texture* load_texture(const char* baked_path, const char* image_path, TextureFormat format) {
+	if (Texture* texture = texture_load(baked_path)) return texture;
+	
+	int width, height, components;
+	auto data = stbi_load(image_path, &width, &height, &components, 3);
+	Texture* texture = texture_create(format, width, height, data, TextureFormat::RGB_U8);
+	stbi_image_free(data);
+	return texture;
+}
+
+// Goes after the #version line and light_grid_glsl(), see init().
+static const char* glsl_surface_pixel_shader_source = R"glsl(
 in vec4 pixel_color;
 in vec2 pixel_uv;
 out vec4 result_color; 
 
-uniform float time;
-
 uniform sampler2D texture0;
 uniform sampler2D texture1;
 
 void main() {
 	vec4 color = texture(texture0, pixel_uv);
-	vec3 normal = normalize(2.0 * texture(texture1, pixel_uv).xyz - 1.0);
 	
-	vec3 light_position = vec3(0.5 + 0.5 * sin(time * 5), 0.5 + 0.5 * cos(time * 5), 1);
-	vec3 delta = vec3(pixel_uv, 0) - light_position; 
+	// Only x and y are read, so this works with both the baked BC5 normal map and the original image.
+	vec2 normal_xy = 2.0 * texture(texture1, pixel_uv).xy - 1.0;
+	vec3 normal = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
 	
-	float factor = 1.0 / dot(delta, delta);
-	factor *= clamp(-dot(normalize(delta), normal), 0, 1);
-	
-	result_color = vec4(color.rgb * factor, color.w);
+	vec3 light = vec3(0.03) + light_grid_light(normal);
+	result_color = vec4(color.rgb * light, color.w);
 }
 
 )glsl";
@@ -52,7 +67,9 @@ void main() {
 bool init() {
 	Paintbox::initialize();
 	
-	surface_pixel_shader = shader_create(ShaderLanguage::GLSL, ShaderType::PIXEL, glsl_surface_pixel_shader_source);
+	char source[8192];
+	snprintf(source, sizeof(source), "#version 430\n%s%s", light_grid_glsl(), glsl_surface_pixel_shader_source);
+	surface_pixel_shader = shader_create(ShaderLanguage::GLSL, ShaderType::PIXEL, source);
 	
 	Vertex vertices[4] = {
 		{{-0.5, -0.5, 0}, {1, 0, 1, 1}, {0, 0}},
@@ -70,13 +87,8 @@ bool init() {
 	
 	stbi_set_flip_vertically_on_load(1);
 	
-	int color_width, color_height, color_components;
-	auto color_data = stbi_load("../assets/materials/gravel/Gravel033_1K_Color.jpg", &color_width, &color_height, &color_components, 4);
-	color_texture = texture_create(TextureFormat::RGBA_U8, color_width, color_height, color_data);
-	
-	int normal_width, normal_height, normal_components;
-	auto normal_data = stbi_load("../assets/materials/gravel/Gravel033_1K_NormalGL.jpg", &normal_width, &normal_height, &normal_components, 4);
-	normal_texture = texture_create(TextureFormat::RGBA_U8, normal_width, normal_height, normal_data);
+	color_texture = load_texture("../assets/materials/gravel/Gravel033_1K_Color.ptex", "../assets/materials/gravel/Gravel033_1K_Color.jpg", TextureFormat::RGBA_U8);
+	normal_texture = load_texture("../assets/materials/gravel/Gravel033_1K_NormalGL.ptex", "../assets/materials/gravel/Gravel033_1K_NormalGL.jpg", TextureFormat::RG_U8); // The shader rebuilds z.
 	
 	return true;
 }
@@ -86,6 +98,8 @@ void do_frame() {
 	
 	int window_width, window_height;
 	glfwGetFramebufferSize(window, &window_width, &window_height);
+	if (window_width == 0 || window_height == 0) return; // Minimized. There's nothing to light, and no grid can be that small.
+	
 	state.viewport.w = window_width;
 	state.viewport.h = window_height;
 	
@@ -94,5 +108,27 @@ void do_frame() {
 	state.pixel_shader = surface_pixel_shader;
 	state.projection = orthographic(-0.8, 0.8, 0.5, -0.5, -1, +1);
 	
+	if (!light_grid || light_grid->width != window_width || light_grid->height != window_height) {
+		if (light_grid) light_grid_destroy(light_grid);
+		light_grid = light_grid_create(window_width, window_height, light_count);
+	}
+	
+	// Lights circling the middle of the window at different speeds, spread out with the golden angle.
+	static PointLight lights[light_count];
+	float time = (float) shader_time();
+	float spread = 0.5f * (window_width < window_height ? window_width : window_height);
+	for (int32_t i = 0; i < light_count; i += 1) {
+		float angle = i * 2.4f + time * (0.2f + (i % 7) * 0.1f);
+		float distance = spread * sqrtf((i + 0.5f) / light_count);
+		
+		lights[i].position = vec3(window_width * 0.5f + cosf(angle) * distance, window_height * 0.5f + sinf(angle) * distance, 40);
+		lights[i].radius = 120;
+		lights[i].color = vec3(0.5f + 0.5f * sinf(i * 0.7f), 0.5f + 0.5f * sinf(i * 1.3f + 2), 0.5f + 0.5f * sinf(i * 1.9f + 4));
+		lights[i].intensity = 0.5f;
+	}
+	
+	light_grid_update(light_grid, lights, light_count);
+	light_grid_bind(light_grid, &state);
+	
 	mesh_render(mesh, &state);
 }
@@ -0,0 +1,97 @@
+#define EXAMPLE_NAME "Vertex Animation"
+#include "common.h"
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+#include <math.h>
+
+// A thousand jelly blobs, each wobbling at its own pace, in a single draw. The wobble is baked into a texture once, at startup,
+// and from then on the CPU doesn't touch a single vertex.
+
+constexpr int32_t grid_size = 8; // Vertices on each side of a blob.
+constexpr int32_t vertex_count = grid_size * grid_size;
+constexpr int32_t frame_count = 48;
+constexpr int32_t instance_count = 1000;
+constexpr int32_t instance_columns = 40;
+
+Mesh* mesh;
+VertexAnimation* animation;
+Buffer* instances;
+
+bool init() {
+	Paintbox::initialize();
+	
+	Vertex vertices[vertex_count];
+	for (int32_t y = 0; y < grid_size; y += 1) {
+		for (int32_t x = 0; x < grid_size; x += 1) {
+			float u = (float) x / (grid_size - 1);
+			float v = (float) y / (grid_size - 1);
+			vertices[y * grid_size + x] = {{2 * u - 1, 2 * v - 1, 0}, {0.3f + 0.7f * u, 0.9f, 0.4f + 0.6f * v, 1}, {u, v}};
+		}
+	}
+	
+	uint32_t indices[(grid_size - 1) * (grid_size - 1) * 6];
+	uint32_t index_count = 0;
+	for (int32_t y = 0; y < grid_size - 1; y += 1) {
+		for (int32_t x = 0; x < grid_size - 1; x += 1) {
+			uint32_t corner = y * grid_size + x;
+			uint32_t quad[6] = {corner, corner + 1, corner + grid_size + 1, corner, corner + grid_size + 1, corner + grid_size};
+			for (int32_t i = 0; i < 6; i += 1) indices[index_count++] = quad[i];
+		}
+	}
+	
+	mesh = mesh_create(vertex_count, index_count, vertices, indices);
+	
+	// Squash and stretch, with a wave running up the blob. The last frame leads back into the first, so the loop is seamless.
+	static vec3 positions[frame_count * vertex_count];
+	for (int32_t frame = 0; frame < frame_count; frame += 1) {
+		float phase = 6.2831853f * frame / frame_count;
+		float squash = 0.15f * sinf(phase);
+		
+		for (int32_t i = 0; i < vertex_count; i += 1) {
+			vec3 rest = vertices[i].position;
+			
+			vec3 position;
+			position.x = rest.x * (1 + squash) + 0.1f * sinf(2 * phase + 3 * rest.y);
+			position.y = rest.y * (1 - squash) - squash;
+			position.z = 0;
+			positions[frame * vertex_count + i] = position;
+		}
+	}
+	
+	animation = vertex_animation_create(TextureFormat::RGBA_F16, vertex_count, frame_count, positions, 24);
+	
+	static VertexAnimationInstance instance_data[instance_count];
+	for (int32_t i = 0; i < instance_count; i += 1) {
+		float column = (float) (i % instance_columns);
+		float row = (float) (i / instance_columns);
+		
+		instance_data[i].offset = vec2((column - (instance_columns - 1) * 0.5f) * 2.5f, (row - 12) * 2.5f);
+		instance_data[i].time_offset = i * 0.618f;
+		instance_data[i].speed = 0.75f + (i % 5) * 0.125f;
+	}
+	instances = buffer_create(sizeof(instance_data), instance_data);
+	
+	return true;
+}
+
+void do_frame() {
+	int window_width, window_height;
+	glfwGetFramebufferSize(window, &window_width, &window_height);
+	if (window_width == 0 || window_height == 0) return; // Minimized. There is nothing to draw into, and the aspect ratio would divide by zero.
+	
+	canvas_clear(nullptr, vec4(0.1f, 0.1f, 0.12f, 1));
+	
+	RenderState state;
+	state.viewport.w = window_width;
+	state.viewport.h = window_height;
+	
+	float half_height = 34;
+	float half_width = half_height * window_width / window_height;
+	state.projection = orthographic(-half_width, half_width, half_height, -half_height, -1, +1);
+	
+	// One draw for every blob. Each frame, the only thing that changes is the time uniform.
+	vertex_animation_bind(animation, &state, instances, instance_count);
+	mesh_render(mesh, &state);
+}
\ No newline at end of file
@@ -1,9 +1,22 @@
 #include "paintbox.h"
 
 #include <stddef.h> // For offsetof
+#include <string.h> // For memcpy
+#include <math.h>   // For ldexpf
+#include <atomic>
 #include "glad/gl.h"
 #include "GLFW/glfw3.h" // #temporary
 
+// #todo: A Vulkan backend for the same API, with pipelines built from the shader linkage, a descriptor set per texture pair,
+// per-frame command buffers and explicit staging uploads, so draws can be recorded on several threads. It should run on the
+// lavapipe CPU driver. It needs a Vulkan loader among the dependencies and SPIR-V shaders, since the GLSL sources here are
+// compiled by the GL driver at runtime. The state caching and draw_list_merge below only trim the GL per-draw overhead meanwhile.
+
+// Comes from EXT_texture_compression_s3tc, which every desktop driver exposes but our glad build doesn't include.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
 static const char* glsl_default_vertex_shader_source = R"glsl(
 #version 410
 
@@ -41,28 +54,75 @@ namespace Paintbox {
 	
 	struct ShaderGL : Shader {
 		GLuint handle = 0; // OpenGL shader handle.
+		GLuint program = 0; // Compute shaders don't get linked with anything else, so they have a program of their own.
+		GLint time_location = -1; // Only for compute shaders, looked up once like the linkages do.
 	};
 	
 	struct TextureGL : Texture {
 		GLuint handle = 0; // OpenGL texture handle.
+		int32_t base_level = 0; // Smallest level index that has been uploaded. Sampling is clamped to base_level and up.
 	};
 	
 	struct CanvasGL : Canvas {
-		GLuint fbo = 0; // OpenGL Framebuffer buffer object.
-		Texture* color_attachment = nullptr;
+		GLuint fbo = 0; // OpenGL Framebuffer buffer object. The color attachment is Canvas::texture.
+		GLuint depth_renderbuffer = 0;
 	};
 	
 	struct MeshGL : Mesh {
 		GLuint vbo = 0; // OpenGL Vertex buffer object.
 		GLuint ibo = 0; // OpenGL Index buffer object.
+		GLenum index_type = GL_UNSIGNED_INT;
+		uint32_t index_size = sizeof(uint32_t);
+		
+		Vertex* mapped_vertices = nullptr; // Set between mesh_map_vertices and mesh_unmap_vertices.
+		bool mapped_for_capture = false;   // Then mapped_vertices is a copy in regular memory, which the capture can record.
+	};
+	
+	struct BufferGL : Buffer {
+		GLuint handle = 0; // OpenGL buffer object.
 	};
 	
 	struct ShaderLinkage {
 		GLuint program = 0;
 		Shader* vertex_shader = 0;
 		Shader* pixel_shader = 0;
+		
+		// Looked up once, when the program is linked. -1 means the program doesn't use the uniform.
+		GLint projection_location = -1;
+		GLint time_location = -1;
+		GLint constants_location = -1;
+		
+		// The values the program has right now. Uniforms live in the program object, so nothing else can change them behind our back.
+		bool uniforms_set = false;
+		mat4 projection;
+		float time = 0;
+		vec4 constants[max_shader_constants];
 	};
 	
+	// The state mesh_render last set on the context, so it only makes the calls that actually change something.
+	// Everything else that binds or enables any of these calls gl_state_forget, and the next draw sets all of it again.
+	// No GL name is ever this, so a cached binding set to it never matches and the next draw binds again.
+	constexpr GLuint gl_unknown_binding = 0xFFFFFFFF;
+	
+	struct GLStateCache {
+		bool valid = false;
+		
+		GLuint program;
+		GLuint framebuffer;
+		Rect viewport;
+		Rect scissor;
+		BlendMode blend_mode;
+		bool depth_test;
+		bool depth_write;
+		GLuint textures[3] = {gl_unknown_binding, gl_unknown_binding, gl_unknown_binding};
+		GLuint storage_buffers[max_bound_buffers];
+		
+		// The element array binding belongs to the vertex array object, and only ever changes while it's bound.
+		GLuint vertex_array;
+		GLuint index_buffer;
+		GLuint vertex_buffer;
+	};
+
 	static GLuint vertex_array_objects[VertexFormat::COUNT];
 	
 	static Shader* default_vertex_shader;
@@ -73,8 +133,18 @@ namespace Paintbox {
 	static int shader_linkage_table_length;
 	static ShaderLinkage shader_linkage_table[shader_linkage_table_capacity]; 
 	
+	static GLStateCache gl_state;
+	
 	static bool backend_initialized;
 	
+	static void gl_state_forget() {
+		gl_state.valid = false;
+		
+		// Draws with null textures skip their units, so 'valid' alone isn't enough: a later draw could still match a handle from
+		// before whatever bound something else to the unit.
+		for (int unit = 0; unit < 3; unit += 1) gl_state.textures[unit] = gl_unknown_binding;
+	}
+	
 	void initialize() {
 		gladLoadGL(glfwGetProcAddress); // #temporary: There should not be a glfw dependency here.
 		
@@ -129,6 +199,7 @@ namespace Paintbox {
 		switch (type) {
 		  case ShaderType::VERTEX: gl_shader_type = GL_VERTEX_SHADER;   break;
 		  case ShaderType::PIXEL:  gl_shader_type = GL_FRAGMENT_SHADER; break;
+		  case ShaderType::COMPUTE: gl_shader_type = GL_COMPUTE_SHADER; break;
 		  default: paintbox_assert(false);
 		}
 		
@@ -146,10 +217,42 @@ namespace Paintbox {
 			return nullptr;
 		}
 		
+		GLuint program = 0;
+		if (type == ShaderType::COMPUTE) {
+			program = glCreateProgram();
+			glAttachShader(program, handle);
+			glLinkProgram(program);
+			
+			int program_linked = 0;
+			glGetProgramiv(program, GL_LINK_STATUS, &program_linked);
+			if (!program_linked) {
+				char message[512];
+				glGetProgramInfoLog(program, sizeof(message), nullptr, message);
+				paintbox_log("Failed to link compute shader:\n%s", message);
+				glDeleteProgram(program);
+				glDeleteShader(handle);
+				return nullptr;
+			}
+		}
+		
 		ShaderGL* result = new ShaderGL; // #memory_cleanup
 		register_resource(result);
 		result->type = type;
 		result->handle = handle;
+		result->program = program;
+		
+		if (program) {
+			// Samplers never change units, so they're set once here instead of at every dispatch.
+			GLint texture0_location = glGetUniformLocation(program, "texture0");
+			if (texture0_location >= 0) glProgramUniform1i(program, texture0_location, 0);
+			
+			GLint texture1_location = glGetUniformLocation(program, "texture1");
+			if (texture1_location >= 0) glProgramUniform1i(program, texture1_location, 1);
+			
+			result->time_location = glGetUniformLocation(program, "time");
+		}
+		
+		capture_shader_create(result, language, type, shader_source_code);
 		return result;
 	}
 	
@@ -157,6 +260,9 @@ namespace Paintbox {
 		if (!vertex_shader) vertex_shader = default_vertex_shader;
 		if (!pixel_shader)  pixel_shader = default_pixel_shader;
 		
+		paintbox_assert(vertex_shader->type == ShaderType::VERTEX);
+		paintbox_assert(pixel_shader->type == ShaderType::PIXEL);
+		
 		// #temporary: This should be a table lookup.
 		for (int i = 0; i < shader_linkage_table_length; i += 1) {
 			ShaderLinkage* entry = &shader_linkage_table[i];
@@ -187,12 +293,28 @@ namespace Paintbox {
 		entry->program = program;
 		entry->vertex_shader = vertex_shader;
 		entry->pixel_shader = pixel_shader;
+		entry->projection_location = glGetUniformLocation(program, "projection");
+		entry->time_location = glGetUniformLocation(program, "time");
+		entry->constants_location = glGetUniformLocation(program, "constants");
+		
+		// The samplers always read from the same texture units, so they are set once here instead of on every draw.
+		GLint texture0_location = glGetUniformLocation(program, "texture0");
+		if (texture0_location >= 0) glProgramUniform1i(program, texture0_location, 0);
+		
+		GLint texture1_location = glGetUniformLocation(program, "texture1");
+		if (texture1_location >= 0) glProgramUniform1i(program, texture1_location, 1);
+		
+		GLint texture2_location = glGetUniformLocation(program, "texture2");
+		if (texture2_location >= 0) glProgramUniform1i(program, texture2_location, 2);
+		
 		return entry;
 	}
 	
-	Mesh* mesh_create(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint32_t indices[]) { 
+	static Mesh* gl_mesh_create(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], void* indices, uint32_t index_size) {
+		gl_state_forget();
+		
 		uint32_t vertex_buffer_size = vertex_count * sizeof(vertices[0]);
-		uint32_t index_buffer_size = index_count * sizeof(indices[0]);
+		uint32_t index_buffer_size = index_count * index_size;
 		
 		// The rationale here is that, if we provide vertices at mesh_create, this mesh is probably going to be static throughout the program; otherwise, we assume it will be updated regularly.
 		// This doesn't have to be true, and OpenGL guaranteees (https://registry.khronos.org/OpenGL-Refpages/gl4/html/glBufferData.xhtml) that these are just hints that are only used for performance optimizations within the driver.
@@ -216,18 +338,50 @@ namespace Paintbox {
 		result->ibo = ibo;
 		result->vertex_count = vertex_count;
 		result->index_count = index_count;
+		result->index_type = index_size == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		result->index_size = index_size;
+		
+		capture_mesh_create(result, vertices, indices, index_size);
 		return result;
+	}
+	
+	Mesh* mesh_create(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint32_t indices[]) {
+		return gl_mesh_create(vertex_count, index_count, vertices, indices, sizeof(uint32_t));
+	}
+	
+	Mesh* mesh_create_u16(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint16_t indices[]) {
+		paintbox_assert(vertex_count <= 65536);
+		return gl_mesh_create(vertex_count, index_count, vertices, indices, sizeof(uint16_t));
 	}	
 	
+	Mesh* mesh_create_from_buffers(Buffer* vertex_buffer, Buffer* index_buffer, uint32_t vertex_count, uint32_t index_count) {
+		paintbox_assert(vertex_count * sizeof(Vertex) <= vertex_buffer->size);
+		paintbox_assert(index_count * sizeof(uint32_t) <= index_buffer->size);
+		
+		// The mesh just borrows the buffer objects, so whatever a compute shader writes into them shows up in the next mesh_render.
+		MeshGL* result = new MeshGL; // #memory_cleanup
+		register_resource(result);
+		result->vbo = ((BufferGL*) vertex_buffer)->handle;
+		result->ibo = ((BufferGL*) index_buffer)->handle;
+		result->vertex_count = vertex_count;
+		result->index_count = index_count;
+		return result;
+	}
+	
 	void mesh_upload(Mesh* mesh, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[]) {
+		gl_state_forget();
+		
 		// #speed: OpenGL syncs internally. This function can take up too much time.
 		// Eventually we should be smarter about memory uploads to the GPU.
 		
 		auto mesh_gl = (MeshGL*) mesh;
 		
+		paintbox_assert(mesh_gl->index_type == GL_UNSIGNED_INT); // #incomplete: Uploads only take 32 bit indices for now.
 		paintbox_assert(vertex_count <= mesh_gl->vertex_count);
 		paintbox_assert(index_count <= mesh_gl->index_count);
 		
+		capture_mesh_upload(mesh, vertex_count, vertices, index_count, indices);
+		
 		int32_t vertex_buffer_size = vertex_count * sizeof(vertices[0]);
 		int32_t index_buffer_size = index_count * sizeof(indices[0]);
 		
@@ -239,77 +393,216 @@ namespace Paintbox {
 		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_buffer_size, indices);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
+	
+	Vertex* mesh_map_vertices(Mesh* mesh) {
+		auto mesh_gl = (MeshGL*) mesh;
+		paintbox_assert(!mesh_gl->mapped_vertices);
+		
+		uint32_t size = mesh->vertex_count * sizeof(Vertex);
+		
+		if (capture_is_active()) {
+			// Whatever gets written into the buffer directly never goes through the capture, so write into a copy and upload it on unmap.
+			mesh_gl->mapped_vertices = (Vertex*) malloc(size);
+			paintbox_assert(mesh_gl->mapped_vertices);
+			mesh_gl->mapped_for_capture = true;
+			return mesh_gl->mapped_vertices;
+		}
+		
+		// Invalidating lets the driver hand out fresh memory instead of waiting for draws that still read the old vertices.
+		// Only GL_ARRAY_BUFFER changes, and it isn't part of the state cache.
+		glBindBuffer(GL_ARRAY_BUFFER, mesh_gl->vbo);
+		mesh_gl->mapped_vertices = (Vertex*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		
+		paintbox_assert_log(mesh_gl->mapped_vertices, "Couldn't map the vertices of a mesh. (%u bytes)", size);
+		return mesh_gl->mapped_vertices;
+	}
+	
+	void mesh_unmap_vertices(Mesh* mesh) {
+		auto mesh_gl = (MeshGL*) mesh;
+		paintbox_assert(mesh_gl->mapped_vertices);
+		
+		if (mesh_gl->mapped_for_capture) {
+			capture_mesh_upload(mesh, mesh->vertex_count, mesh_gl->mapped_vertices, 0, nullptr);
+			
+			glBindBuffer(GL_ARRAY_BUFFER, mesh_gl->vbo);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, mesh->vertex_count * sizeof(Vertex), mesh_gl->mapped_vertices);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			
+			free(mesh_gl->mapped_vertices);
+			mesh_gl->mapped_vertices = nullptr;
+			mesh_gl->mapped_for_capture = false;
+			return;
+		}
+		
+		glBindBuffer(GL_ARRAY_BUFFER, mesh_gl->vbo);
+		GLboolean intact = glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		mesh_gl->mapped_vertices = nullptr;
+		
+		// #robustness: The contents get lost when the display mode changes, among other things. The mesh shows garbage until the next time it's written.
+		if (!intact) paintbox_log("The vertices of a mesh (%llu) were lost while it was mapped.", (unsigned long long) mesh->uid);
+	}
 
-	void mesh_render(Mesh* mesh, RenderState* state, int32_t index_count) {
+	static void gl_bind_buffers(Buffer* buffers[max_bound_buffers]) {
+		for (int i = 0; i < max_bound_buffers; i += 1) {
+			GLuint handle = buffers[i] ? ((BufferGL*) buffers[i])->handle : 0;
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, handle);
+		}
+	}
+	
+	static void gl_apply_blend_mode(BlendMode blend_mode) {
+		if (blend_mode == BlendMode::NONE) {
+			glDisable(GL_BLEND);
+			return;
+		}
+		
+		glEnable(GL_BLEND);
+		glBlendEquation(GL_FUNC_ADD);
+		
+		switch (blend_mode) {
+		  case BlendMode::ALPHA:               glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+		  case BlendMode::PREMULTIPLIED_ALPHA: glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+		  case BlendMode::ADDITIVE:            glBlendFunc(GL_SRC_ALPHA, GL_ONE); break;
+		  default: paintbox_assert(false);
+		}
+	}
+	
+	static bool rects_equal(Rect a, Rect b) {
+		return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+	}
+	
+	static void gl_apply_scissor(Rect scissor) {
+		if (scissor.w > 0 && scissor.h > 0) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor((GLint) scissor.x, (GLint) scissor.y, (GLsizei) scissor.w, (GLsizei) scissor.h);
+		} else {
+			glDisable(GL_SCISSOR_TEST);
+		}
+	}
+	
+	void mesh_render(Mesh* mesh, RenderState* state, int32_t index_count, uint32_t first_index) {
 		auto mesh_gl = (MeshGL*) mesh;
 		
-		if (index_count < 0) index_count = mesh_gl->index_count;
+		if (index_count < 0) index_count = mesh_gl->index_count - first_index;
+		paintbox_assert(first_index + index_count <= (uint32_t) mesh_gl->index_count);
+		paintbox_assert_log(!mesh_gl->mapped_vertices, "Meshes can't be rendered while their vertices are mapped.");
+		
+		double time = shader_time();
+		capture_mesh_render(mesh, state, index_count, first_index, time);
 		
 		auto linkage = gl_get_or_create_shader_linkage(state->vertex_shader, state->pixel_shader);
 		paintbox_assert(linkage);
-		glUseProgram(linkage->program);
+		
+		bool known = gl_state.valid;
+		
+		if (!known || gl_state.program != linkage->program) {
+			glUseProgram(linkage->program);
+			gl_state.program = linkage->program;
+		}
+		
+		GLuint framebuffer = state->canvas ? ((CanvasGL*) state->canvas)->fbo : 0;
+		if (!known || gl_state.framebuffer != framebuffer) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			gl_state.framebuffer = framebuffer;
+		}
 		
 		Rect viewport = state->viewport;
-		glViewport(viewport.x, viewport.y, viewport.w, viewport.h);
+		if (!known || !rects_equal(gl_state.viewport, viewport)) {
+			glViewport(viewport.x, viewport.y, viewport.w, viewport.h);
+			gl_state.viewport = viewport;
+		}
 		
-		if (state->texture0) {
-			auto texture0_gl = (TextureGL*) state->texture0;
+		if (!known || !rects_equal(gl_state.scissor, state->scissor)) {
+			gl_apply_scissor(state->scissor);
+			gl_state.scissor = state->scissor;
+		}
+		
+		if (!known || gl_state.blend_mode != state->blend_mode) {
+			gl_apply_blend_mode(state->blend_mode);
+			gl_state.blend_mode = state->blend_mode;
+		}
+		
+		if (!known || gl_state.depth_test != state->depth_test || gl_state.depth_write != state->depth_write) {
+			// GL only writes depth while the depth test is on, so a write without a test is a test that always passes.
+			if (state->depth_test || state->depth_write) {
+				glEnable(GL_DEPTH_TEST);
+				glDepthFunc(state->depth_test ? GL_LEQUAL : GL_ALWAYS);
+			} else {
+				glDisable(GL_DEPTH_TEST);
+			}
+			glDepthMask(state->depth_write ? GL_TRUE : GL_FALSE);
 			
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texture0_gl->handle);
+			gl_state.depth_test = state->depth_test;
+			gl_state.depth_write = state->depth_write;
 		}
 		
-		if (state->texture1) {
-			auto texture1_gl = (TextureGL*) state->texture1;
+		// Null textures leave whatever was bound to the unit, like they always have.
+		Texture* textures[3] = {state->texture0, state->texture1, state->texture2};
+		for (int unit = 0; unit < 3; unit += 1) {
+			if (!textures[unit]) continue;
 			
-			glActiveTexture(GL_TEXTURE1);
-			glBindTexture(GL_TEXTURE_2D, texture1_gl->handle);
+			GLuint handle = ((TextureGL*) textures[unit])->handle;
+			if (!known || gl_state.textures[unit] != handle) {
+				glActiveTexture(GL_TEXTURE0 + unit);
+				glBindTexture(GL_TEXTURE_2D, handle);
+				gl_state.textures[unit] = handle;
+			}
 		}
 		
+		for (int i = 0; i < max_bound_buffers; i += 1) {
+			GLuint handle = state->buffers[i] ? ((BufferGL*) state->buffers[i])->handle : 0;
+			if (!known || gl_state.storage_buffers[i] != handle) {
+				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, handle);
+				gl_state.storage_buffers[i] = handle;
+			}
+		}
 		
 		// Apply uniforms
-		GLuint projection_uniform_loc = glGetUniformLocation(linkage->program, "projection");
-		if (projection_uniform_loc >= 0) {
-			glUniformMatrix4fv(projection_uniform_loc, 1, GL_TRUE, (float*) &state->projection);
-		} else {
-			// #incomplete #robustness: Provide a helpful error message here.
-		}
+		bool uniforms_set = linkage->uniforms_set;
 		
-		GLuint texture0_uniform_loc = glGetUniformLocation(linkage->program, "texture0");
-		if (texture0_uniform_loc >= 0) {
-			glUniform1i(texture0_uniform_loc, 0);
-		} else {
-			// #incomplete #robustness: Provide a helpful error message here.
+		if (linkage->projection_location >= 0 && (!uniforms_set || memcmp(&linkage->projection, &state->projection, sizeof(mat4)) != 0)) {
+			glUniformMatrix4fv(linkage->projection_location, 1, GL_TRUE, (float*) &state->projection);
 		}
+		linkage->projection = state->projection;
 		
-		GLuint texture1_uniform_loc = glGetUniformLocation(linkage->program, "texture1");
-		if (texture1_uniform_loc >= 0) {
-			glUniform1i(texture1_uniform_loc, 1);
-		} else {
-			// #incomplete #robustness: Provide a helpful error message here.
+		if (linkage->time_location >= 0 && (!uniforms_set || linkage->time != (float) time)) {
+			glUniform1f(linkage->time_location, time);
 		}
+		linkage->time = (float) time;
 		
-		GLuint time_uniform_loc = glGetUniformLocation(linkage->program, "time");
-		if (time_uniform_loc >= 0) {
-			glUniform1f(time_uniform_loc, glfwGetTime()); // #temporary
-		} else {
-			// #incomplete #robustness: Provide a helpful error message here.
+		if (linkage->constants_location >= 0 && (!uniforms_set || memcmp(linkage->constants, state->constants, sizeof(state->constants)) != 0)) {
+			glUniform4fv(linkage->constants_location, max_shader_constants, (float*) state->constants);
 		}
+		memcpy(linkage->constants, state->constants, sizeof(state->constants));
 		
-		glBindVertexArray(vertex_array_objects[(int) VertexFormat::XYZ_RGBA_UV]);
+		linkage->uniforms_set = true;
 		
 		static_assert((int) VertexFormat::COUNT == 1, "We assume all meshes use XYZ_RGBA_UV for now.");
+		GLuint vertex_array = vertex_array_objects[(int) VertexFormat::XYZ_RGBA_UV];
 		
 		// Bind the vertex format and mesh buffers
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_gl->ibo);
-		glBindVertexBuffer(0, mesh_gl->vbo, 0, sizeof(Vertex));
+		if (!known || gl_state.vertex_array != vertex_array) {
+			glBindVertexArray(vertex_array);
+			gl_state.vertex_array = vertex_array;
+			known = false; // A different vertex array has its own buffer bindings.
+		}
 		
-		glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, (void*) 0);
+		if (!known || gl_state.index_buffer != mesh_gl->ibo) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_gl->ibo);
+			gl_state.index_buffer = mesh_gl->ibo;
+		}
 		
-		// Maybe these are not necessary, but I'm being paranoid here.
-		glBindVertexArray(0);
-		glUseProgram(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		if (!known || gl_state.vertex_buffer != mesh_gl->vbo) {
+			glBindVertexBuffer(0, mesh_gl->vbo, 0, sizeof(Vertex));
+			gl_state.vertex_buffer = mesh_gl->vbo;
+		}
+		
+		gl_state.valid = true;
+		
+		glDrawElementsInstanced(GL_TRIANGLES, index_count, mesh_gl->index_type, (void*) ((uintptr_t) first_index * mesh_gl->index_size), state->instance_count);
+		
+		// Everything stays bound for the next draw. Whoever binds something else calls gl_state_forget.
 	}
 
 	
@@ -318,6 +611,7 @@ namespace Paintbox {
 		GLenum gl_internal_format;
 		GLenum gl_type;
 		GLint gl_swizzle[4];
+		bool compressed; // Block compressed formats have no gl_format or gl_type.
 	};
 	
 	static GLTextureFormatInfo gl_get_texture_format_info(TextureFormat format) {
@@ -336,7 +630,7 @@ namespace Paintbox {
 			} break;
 			
 		  case TextureFormat::RGBA_S8: {
-				info.gl_internal_format = GL_RGBA8; 
+				info.gl_internal_format = GL_RGBA8_SNORM; // Plain GL_RGBA8 would clamp every negative component to 0 on upload.
 				info.gl_type = GL_BYTE;
 				info.gl_format = GL_RGBA;
 			} break;
@@ -358,7 +652,29 @@ namespace Paintbox {
 				info.gl_swizzle[2] = GL_ONE;
 				info.gl_swizzle[3] = GL_RED;
 			} break;
-			
+		
+		  case TextureFormat::BC1_RGB: {
+				info.gl_internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+				info.compressed = true;
+			} break;
+		
+		  case TextureFormat::BC5_RG: {
+				info.gl_internal_format = GL_COMPRESSED_RG_RGTC2;
+				info.compressed = true;
+			} break;
+		
+		  case TextureFormat::RGB_U8: {
+				info.gl_internal_format = GL_RGB8;
+				info.gl_type = GL_UNSIGNED_BYTE;
+				info.gl_format = GL_RGB;
+			} break;
+		
+		  case TextureFormat::RG_U8: {
+				info.gl_internal_format = GL_RG8;
+				info.gl_type = GL_UNSIGNED_BYTE;
+				info.gl_format = GL_RG;
+			} break;
+
 		  default: 
 			paintbox_assert(false);
 		}	
@@ -366,13 +682,18 @@ namespace Paintbox {
 		return info;
 	}
 	
-	Texture* texture_create(TextureFormat format, int32_t width, int32_t height, void* image_data) {
-		auto format_info = gl_get_texture_format_info(format);
+	static TextureGL* gl_texture_create(TextureFormat format, int32_t width, int32_t height, void* image_data) {
+		gl_state_forget();
+		
+		auto format_info= gl_get_texture_format_info(format);
+		paintbox_assert_log(!format_info.compressed, "texture_create() can't make block compressed textures. Use texture_allocate and texture_upload_mip instead.");
 		
 		GLuint handle;
 		glGenTextures(1, &handle);
 		glBindTexture(GL_TEXTURE_2D, handle);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB_U8 and RG_U8 rows aren't always a multiple of 4 bytes.
 		glTexImage2D(GL_TEXTURE_2D, 0, format_info.gl_internal_format, width, height, 0, format_info.gl_format, format_info.gl_type, image_data);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 		
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -389,4 +710,571 @@ namespace Paintbox {
 		return texture;
 	}
 	
+	Texture* texture_create(TextureFormat format, int32_t width, int32_t height, void* image_data, TextureFormat source_format, uint32_t convert_flags) {
+		if (source_format == TextureFormat::NONE) source_format = format;
+		
+		void* converted = nullptr;
+		if (image_data && (source_format != format || convert_flags != 0)) {
+			converted = malloc(texture_level_size(format, width, height));
+			paintbox_assert(converted);
+			texture_convert(format, converted, source_format, image_data, width, height, convert_flags);
+			image_data = converted;
+		}
+		
+		TextureGL* texture = gl_texture_create(format, width, height, image_data);
+		capture_texture_create(texture, image_data); // The converted data, so the replay doesn't convert again.
+		free(converted);
+		return texture;
+	}
+	
+	void texture_update(Texture* texture, int32_t x, int32_t y, int32_t width, int32_t height, void* data, int32_t data_row_length) {
+		gl_state_forget();
+		
+		paintbox_assert(x >= 0 && y >= 0 && x + width <= texture->width && y + height <= texture->height);
+		
+		auto texture_gl = (TextureGL*) texture;
+		auto format_info = gl_get_texture_format_info(texture->format);
+		paintbox_assert_log(!format_info.compressed, "texture_update() can't write into block compressed textures. Use texture_upload_mip instead.");
+		
+		capture_texture_update(texture, x, y, width, height, data, data_row_length);
+		
+		glBindTexture(GL_TEXTURE_2D, texture_gl->handle);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, data_row_length);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format_info.gl_format, format_info.gl_type, data);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	
+	Texture* texture_allocate(TextureFormat format, int32_t width, int32_t height, int32_t mip_count) {
+		gl_state_forget();
+		
+		paintbox_assert(mip_count >= 1 && mip_count <= max_texture_mips);
+		paintbox_assert(((width | height) >> (mip_count - 1)) > 0); // The smallest level must still be at least 1x1.
+		
+		auto format_info = gl_get_texture_format_info(format);
+		
+		GLuint handle;
+		glGenTextures(1, &handle);
+		glBindTexture(GL_TEXTURE_2D, handle);
+		glTexStorage2D(GL_TEXTURE_2D, mip_count, format_info.gl_internal_format, width, height);
+		
+		// Nothing is uploaded yet, so there is nothing to sample. texture_upload_mip lowers the base level as the levels come in.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mip_count - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mip_count - 1);
+		
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mip_count > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format_info.gl_swizzle);
+		
+		glBindTexture(GL_TEXTURE_2D, 0);
+		
+		TextureGL* texture = new TextureGL; // #memory_cleanup
+		register_resource(texture);
+		texture->format = format;
+		texture->width = width;
+		texture->height = height;
+		texture->mip_count = mip_count;
+		texture->handle = handle;
+		texture->base_level = mip_count; // One past the last level: nothing uploaded.
+		
+		capture_texture_allocate(texture);
+		return texture;
+	}
+	
+	void texture_upload_mip(Texture* texture, int32_t level, void* data, uint32_t size) {
+		gl_state_forget();
+		
+		paintbox_assert(level >= 0 && level < texture->mip_count);
+		
+		auto texture_gl = (TextureGL*) texture;
+		auto format_info = gl_get_texture_format_info(texture->format);
+		
+		int32_t width = texture->width >> level;
+		int32_t height = texture->height >> level;
+		if (width < 1) width = 1;
+		if (height < 1) height = 1;
+		
+		paintbox_assert(size == texture_level_size(texture->format, width, height));
+		
+		capture_texture_upload_mip(texture, level, data, size);
+		
+		glBindTexture(GL_TEXTURE_2D, texture_gl->handle);
+		
+		if (format_info.compressed) {
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format_info.gl_internal_format, size, data);
+		} else {
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format_info.gl_format, format_info.gl_type, data);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		}
+		
+		// Levels are expected smallest first. The base level only moves once the chain from it to the smallest level is complete, so sampling never touches a level without contents.
+		if (level == texture_gl->base_level - 1) {
+			texture_gl->base_level = level;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+		}
+		
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	
+	Buffer* buffer_create(uint32_t size, void* data) {
+		GLuint handle;
+		glGenBuffers(1, &handle);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, handle);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		
+		BufferGL* result = new BufferGL; // #memory_cleanup
+		register_resource(result);
+		result->size = size;
+		result->handle = handle;
+		
+		capture_buffer_create(result, data);
+		return result;
+	}
+	
+	void buffer_upload(Buffer* buffer, uint32_t offset, uint32_t size, void* data) {
+		paintbox_assert(offset + size <= buffer->size);
+		
+		capture_buffer_upload(buffer, offset, size, data);
+		
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ((BufferGL*) buffer)->handle);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+	
+	void buffer_destroy(Buffer* buffer) {
+		// The buffer may still be in the cached storage bindings, and glGenBuffers can hand out its name again, so the cache can't be trusted after this.
+		gl_state_forget();
+		
+		// #incomplete: The capture doesn't record this, so a replay keeps the buffer until it ends.
+		auto buffer_gl = (BufferGL*) buffer;
+		glDeleteBuffers(1, &buffer_gl->handle);
+		delete buffer_gl;
+	}
+	
+	void compute_dispatch(ComputeState* state, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+		gl_state_forget();
+		
+		paintbox_assert(state->compute_shader && state->compute_shader->type == ShaderType::COMPUTE);
+		
+		auto shader_gl = (ShaderGL*) state->compute_shader;
+		glUseProgram(shader_gl->program);
+		
+		if (state->texture0) {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, ((TextureGL*) state->texture0)->handle);
+		}
+		
+		if (state->texture1) {
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, ((TextureGL*) state->texture1)->handle);
+		}
+		
+		gl_bind_buffers(state->buffers);
+		
+		if (shader_gl->time_location >= 0) glUniform1f(shader_gl->time_location, shader_time());
+		
+		glDispatchCompute(group_count_x, group_count_y, group_count_z);
+		
+		glUseProgram(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	
+	void memory_barrier(uint32_t barrier_bits) {
+		GLbitfield gl_barrier_bits = 0;
+		
+		if (barrier_bits == BARRIER_ALL) {
+			gl_barrier_bits = GL_ALL_BARRIER_BITS;
+		} else {
+			if (barrier_bits & BARRIER_VERTEX_BUFFER)  gl_barrier_bits |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+			if (barrier_bits & BARRIER_INDEX_BUFFER)   gl_barrier_bits |= GL_ELEMENT_ARRAY_BARRIER_BIT;
+			if (barrier_bits & BARRIER_STORAGE_BUFFER) gl_barrier_bits |= GL_SHADER_STORAGE_BARRIER_BIT;
+			if (barrier_bits & BARRIER_TEXTURE_FETCH)  gl_barrier_bits |= GL_TEXTURE_FETCH_BARRIER_BIT;
+			if (barrier_bits & BARRIER_BUFFER_UPDATE)  gl_barrier_bits |= GL_BUFFER_UPDATE_BARRIER_BIT;
+		}
+		
+		if (gl_barrier_bits) glMemoryBarrier(gl_barrier_bits);
+	}
+	
+	static bool time_overridden;
+	static double time_override_value;
+	
+	double shader_time() {
+		if (time_overridden) return time_override_value;
+		return glfwGetTime(); // #temporary
+	}
+	
+	void time_override(double seconds) {
+		time_overridden = true;
+		time_override_value = seconds;
+	}
+	
+	void time_override_clear() {
+		time_overridden = false;
+	}
+	
+	void gpu_finish() {
+		glFinish();
+	}
+	
+	void gpu_state_invalidate() {
+		gl_state_forget();
+	}
+	
+	Canvas* canvas_create(TextureFormat format, int32_t width, int32_t height) {
+		gl_state_forget();
+		
+		Texture* texture = gl_texture_create(format, width, height, nullptr); // Not captured on its own: replaying the canvas creates it again.
+		
+		GLuint fbo;
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ((TextureGL*) texture)->handle, 0);
+		
+		// Depth is never sampled, so a renderbuffer is enough.
+		GLuint depth_renderbuffer;
+		glGenRenderbuffers(1, &depth_renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+		
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			paintbox_log("Failed to create a %dx%d canvas, framebuffer status is 0x%x.", width, height, status);
+			glDeleteFramebuffers(1, &fbo);
+			glDeleteRenderbuffers(1, &depth_renderbuffer);
+			return nullptr; // #memory_cleanup: The texture leaks here.
+		}
+		
+		CanvasGL* canvas = new CanvasGL; // #memory_cleanup
+		register_resource(canvas);
+		canvas->format = format;
+		canvas->width = width;
+		canvas->height = height;
+		canvas->texture = texture;
+		canvas->fbo = fbo;
+		canvas->depth_renderbuffer = depth_renderbuffer;
+		
+		capture_canvas_create(canvas);
+		return canvas;
+	}
+	
+	void canvas_clear(Canvas* canvas, vec4 color, float depth, Rect rect) {
+		gl_state_forget();
+		
+		capture_canvas_clear(canvas, color, depth, rect);
+		
+		glBindFramebuffer(GL_FRAMEBUFFER, canvas ? ((CanvasGL*) canvas)->fbo : 0);
+		gl_apply_scissor(rect);
+		
+		// Clears respect the write masks, so make sure both are on.
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthMask(GL_TRUE);
+		
+		glClearColor(color.x, color.y, color.z, color.w);
+		glClearDepth(depth);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		
+		glDisable(GL_SCISSOR_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	
+	void canvas_blit(Canvas* source, Canvas* destination, Rect rect) {
+		gl_state_forget();
+		
+		paintbox_assert(source);
+		capture_canvas_blit(source, destination, rect);
+		
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, ((CanvasGL*) source)->fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination ? ((CanvasGL*) destination)->fbo : 0);
+		glDisable(GL_SCISSOR_TEST);
+		
+		GLint x0 = (GLint) rect.x;
+		GLint y0 = (GLint) rect.y;
+		GLint x1 = (GLint) (rect.x + rect.w);
+		GLint y1 = (GLint) (rect.y + rect.h);
+		glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	
+	//
+	// Readback
+	//
+	
+	enum class ReadbackState {
+		FREE,
+		IN_FLIGHT,  // Waiting on the GPU fence.
+		CONVERTING, // A worker thread is turning the pixels into RGBA_U8.
+		READY,
+	};
+	
+	struct ReadbackSlot {
+		ReadbackState state = ReadbackState::FREE;
+		uint32_t generation = 0; // Bumped every time the slot is reused, so stale tickets don't match.
+		
+		GLuint pbo = 0;
+		uint32_t pbo_size = 0;
+		GLsync fence = 0;
+		
+		TextureFormat format {};
+		int32_t width = 0;
+		int32_t height = 0;
+		bool convert_to_rgba_u8 = false;
+		
+		// The pixels end up here, so the pixel buffer can go back to the GPU as soon as the copy is done.
+		uint8_t* data = nullptr;
+		uint32_t data_capacity = 0;
+		uint32_t data_size = 0;
+		
+		uint8_t* converted = nullptr;
+		uint32_t converted_capacity = 0;
+		std::atomic<bool> conversion_done {false};
+	};
+	
+	constexpr int readback_pool_capacity = 16;
+	static ReadbackSlot readback_pool[readback_pool_capacity];
+	
+	static uint32_t gl_texture_format_pixel_size(TextureFormat format) {
+		switch (format) {
+		  case TextureFormat::RGBA_U8:   return 4;
+		  case TextureFormat::RGBA_S8:   return 4;
+		  case TextureFormat::RGBA_F16:  return 8;
+		  case TextureFormat::ALPHA_F32: return 4;
+		  case TextureFormat::RGB_U8:    return 3;
+		  case TextureFormat::RG_U8:     return 2;
+		  default: paintbox_assert(false);
+		}
+		return 0;
+	}
+	
+	static ReadbackSlot* readback_find_slot(ReadbackTicket ticket) {
+		if (ticket == 0) return nullptr;
+		
+		uint32_t index = (uint32_t) (ticket & 0xFF);
+		uint32_t generation = (uint32_t) (ticket >> 8);
+		if (index >= readback_pool_capacity) return nullptr;
+		
+		ReadbackSlot* slot = &readback_pool[index];
+		if (slot->state == ReadbackState::FREE || slot->generation != generation) return nullptr;
+		return slot;
+	}
+	
+	static void ensure_capacity(uint8_t** memory, uint32_t* capacity, uint32_t size) {
+		if (size <= *capacity) return;
+		*memory = (uint8_t*) realloc(*memory, size);
+		paintbox_assert(*memory);
+		*capacity = size;
+	}
+	
+	static float half_to_float(uint16_t h) {
+		uint32_t sign = h >> 15;
+		uint32_t exponent = (h >> 10) & 0x1F;
+		uint32_t mantissa = h & 0x3FF;
+		
+		float value;
+		if (exponent == 0)       value = ldexpf((float) mantissa, -24); // Subnormal
+		else if (exponent == 31) value = mantissa ? 0.0f : 65504.0f;     // NaN and infinity, clamped since we only care about colors.
+		else                     value = ldexpf((float) (mantissa | 0x400), (int) exponent - 25);
+		
+		return sign ? -value : value;
+	}
+	
+	static uint8_t unorm_to_u8(float value) {
+		if (!(value > 0)) return 0; // Also catches NaN.
+		if (value >= 1) return 255;
+		return (uint8_t) (value * 255 + 0.5f);
+	}
+	
+	static void readback_convert(void* user_data) {
+		auto slot = (ReadbackSlot*) user_data;
+		
+		uint32_t pixel_count = slot->width * slot->height;
+		uint8_t* out = slot->converted;
+		
+		switch (slot->format) {
+		  case TextureFormat::RGBA_S8: {
+				auto in = (int8_t*) slot->data;
+				for (uint32_t i = 0; i < pixel_count * 4; i += 1) {
+					float value = in[i] < -127 ? -1.0f : in[i] / 127.0f;
+					out[i] = unorm_to_u8(value * 0.5f + 0.5f);
+				}
+			} break;
+		
+		  case TextureFormat::RGBA_F16: {
+				auto in = (uint16_t*) slot->data;
+				for (uint32_t i = 0; i < pixel_count * 4; i += 1) out[i] = unorm_to_u8(half_to_float(in[i]));
+			} break;
+		
+		  case TextureFormat::ALPHA_F32: {
+				auto in = (float*) slot->data;
+				for (uint32_t i = 0; i < pixel_count; i += 1) {
+					out[i * 4 + 0] = 255;
+					out[i * 4 + 1] = 255;
+					out[i * 4 + 2] = 255;
+					out[i * 4 + 3] = unorm_to_u8(in[i]);
+				}
+			} break;
+		
+		  case TextureFormat::RGB_U8: {
+				auto in = (uint8_t*) slot->data;
+				for (uint32_t i = 0; i < pixel_count; i += 1) {
+					out[i * 4 + 0] = in[i * 3 + 0];
+					out[i * 4 + 1] = in[i * 3 + 1];
+					out[i * 4 + 2] = in[i * 3 + 2];
+					out[i * 4 + 3] = 255;
+				}
+			} break;
+		
+		  case TextureFormat::RG_U8: {
+				auto in = (uint8_t*) slot->data;
+				for (uint32_t i = 0; i < pixel_count; i += 1) {
+					out[i * 4 + 0] = in[i * 2 + 0];
+					out[i * 4 + 1] = in[i * 2 + 1];
+					out[i * 4 + 2] = 0;
+					out[i * 4 + 3] = 255;
+				}
+			} break;
+		
+		  default: paintbox_assert(false);
+		}
+		
+		slot->conversion_done.store(true, std::memory_order_release);
+	}
+	
+	ReadbackTicket canvas_read_async(Canvas* canvas, Rect rect, TextureFormat format, bool convert_to_rgba_u8) {
+		int32_t source_width, source_height;
+		if (canvas) {
+			source_width = canvas->width;
+			source_height = canvas->height;
+		} else {
+			glfwGetFramebufferSize(glfwGetCurrentContext(), &source_width, &source_height); // #temporary
+		}
+		
+		// Checked before anything is sized from the rect, since a negative size would wrap around in data_size.
+		paintbox_assert(rect.w > 0 && rect.h > 0);
+		paintbox_assert(rect.x >= 0 && rect.y >= 0 && rect.x + rect.w <= source_width && rect.y + rect.h <= source_height);
+		
+		int32_t slot_index = -1;
+		for (int32_t i = 0; i < readback_pool_capacity; i += 1) {
+			if (readback_pool[i].state == ReadbackState::FREE) {
+				slot_index = i;
+				break;
+			}
+		}
+		if (slot_index < 0) return 0; // #robustness: The caller is reading faster than it releases. Maybe we should grow the pool instead.
+		
+		ReadbackSlot* slot = &readback_pool[slot_index];
+		slot->generation += 1;
+		slot->format = format;
+		slot->width = (int32_t) rect.w;
+		slot->height = (int32_t) rect.h;
+		slot->convert_to_rgba_u8 = convert_to_rgba_u8 && format != TextureFormat::RGBA_U8;
+		slot->data_size = slot->width * slot->height * gl_texture_format_pixel_size(format);
+		
+		if (!slot->pbo) glGenBuffers(1, &slot->pbo);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+		if (slot->pbo_size < slot->data_size) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, slot->data_size, nullptr, GL_STREAM_READ);
+			slot->pbo_size = slot->data_size;
+		}
+		
+		auto format_info = gl_get_texture_format_info(format);
+		
+		if (canvas) {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, ((CanvasGL*) canvas)->fbo);
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+		} else {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+			glReadBuffer(GL_BACK);
+		}
+		
+		// With a pack buffer bound, glReadPixels only queues the copy and returns right away.
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels((GLint) rect.x, (GLint) rect.y, slot->width, slot->height, format_info.gl_format, format_info.gl_type, (void*) 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		
+		slot->state = ReadbackState::IN_FLIGHT;
+		return ((ReadbackTicket) slot->generation << 8) | (ReadbackTicket) slot_index;
+	}
+	
+	bool readback_poll(ReadbackTicket ticket, ReadbackResult* result) {
+		ReadbackSlot* slot = readback_find_slot(ticket);
+		paintbox_assert_log(slot, "readback_poll() got a ticket that was already released, or was never valid.");
+		
+		if (slot->state == ReadbackState::IN_FLIGHT) {
+			// Zero timeout: we only ask if the fence is done, we never wait on it.
+			GLenum wait_result = glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (wait_result != GL_ALREADY_SIGNALED && wait_result != GL_CONDITION_SATISFIED) return false;
+			
+			glDeleteSync(slot->fence);
+			slot->fence = 0;
+			
+			ensure_capacity(&slot->data, &slot->data_capacity, slot->data_size);
+			
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+			void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot->data_size, GL_MAP_READ_BIT);
+			paintbox_assert(mapped);
+			memcpy(slot->data, mapped, slot->data_size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			
+			if (slot->convert_to_rgba_u8) {
+				ensure_capacity(&slot->converted, &slot->converted_capacity, slot->width * slot->height * 4);
+				slot->conversion_done.store(false);
+				slot->state = ReadbackState::CONVERTING;
+				job_run_async(readback_convert, slot);
+			} else {
+				slot->state = ReadbackState::READY;
+			}
+		}
+		
+		if (slot->state == ReadbackState::CONVERTING) {
+			if (!slot->conversion_done.load(std::memory_order_acquire)) return false;
+			slot->state = ReadbackState::READY;
+		}
+		
+		result->width = slot->width;
+		result->height = slot->height;
+		
+		if (slot->convert_to_rgba_u8) {
+			result->data = slot->converted;
+			result->size = slot->width * slot->height * 4;
+			result->format = TextureFormat::RGBA_U8;
+		} else {
+			result->data = slot->data;
+			result->size = slot->data_size;
+			result->format = slot->format;
+		}
+		
+		return true;
+	}
+	
+	void readback_release(ReadbackTicket ticket) {
+		ReadbackSlot* slot = readback_find_slot(ticket);
+		if (!slot) return;
+		
+		if (slot->state == ReadbackState::CONVERTING) {
+			// The worker still holds on to the slot memory, so we have to let it finish.
+			while (!slot->conversion_done.load(std::memory_order_acquire)) {}
+		}
+		
+		if (slot->fence) {
+			glDeleteSync(slot->fence);
+			slot->fence = 0;
+		}
+		
+		slot->state = ReadbackState::FREE;
+	}
 }
\ No newline at end of file
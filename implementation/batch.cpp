@@ -0,0 +1,42 @@
+#include "paintbox.h"
+
+namespace Paintbox {
+	
+	void batch_clear(Batch* batch) {
+		batch->vertex_count = 0;
+		batch->index_count = 0;
+	}
+	
+	void batch_free(Batch* batch) {
+		free(batch->vertices);
+		free(batch->indices);
+		*batch = {};
+	}
+	
+	void batch_reserve(Batch* batch, uint32_t vertex_count, uint32_t index_count) {
+		uint32_t needed_vertices = batch->vertex_count + vertex_count;
+		if (needed_vertices > batch->vertex_capacity) {
+			uint32_t capacity = batch->vertex_capacity ? batch->vertex_capacity * 2 : 1024;
+			while (capacity < needed_vertices) capacity *= 2;
+			
+			batch->vertices = (Vertex*) realloc(batch->vertices, capacity * sizeof(Vertex));
+			paintbox_assert(batch->vertices);
+			batch->vertex_capacity = capacity;
+		}
+		
+		uint32_t needed_indices = batch->index_count + index_count;
+		if (needed_indices > batch->index_capacity) {
+			uint32_t capacity = batch->index_capacity ? batch->index_capacity * 2 : 1024;
+			while (capacity < needed_indices) capacity *= 2;
+			
+			batch->indices = (uint32_t*) realloc(batch->indices, capacity * sizeof(uint32_t));
+			paintbox_assert(batch->indices);
+			batch->index_capacity = capacity;
+		}
+	}
+	
+	void batch_upload(Batch* batch, Mesh* mesh) {
+		mesh_upload(mesh, batch->vertex_count, batch->vertices, batch->index_count, batch->indices);
+	}
+
+}
\ No newline at end of file
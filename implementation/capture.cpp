@@ -0,0 +1,715 @@
+#include "paintbox.h"
+
+#include <stddef.h> // For offsetof
+#include <string.h> // For memcpy, memcmp, strlen
+#include <chrono>
+
+namespace Paintbox {
+	
+	//
+	// Trace format
+	//
+	// A TraceHeader followed by records. Every record starts with a RecordHeader and its payload size is padded to 8 bytes, so blobs in a mapped trace stay aligned.
+	// Resources are referred to by their uid at capture time. Zero means null.
+	//
+	
+	constexpr uint32_t trace_magic = 0x43525450; // "PTRC"
+	constexpr uint32_t trace_version = 5;
+	
+	struct TraceHeader {
+		uint32_t magic;
+		uint32_t version;
+	};
+	
+	enum class RecordType : uint32_t {
+		SHADER_CREATE,
+		TEXTURE_CREATE,
+		TEXTURE_UPDATE,
+		TEXTURE_ALLOCATE,
+		TEXTURE_UPLOAD_MIP,
+		CANVAS_CREATE,
+		CANVAS_CLEAR,
+		CANVAS_BLIT,
+		MESH_CREATE,
+		MESH_UPLOAD,
+		MESH_RENDER,
+		BUFFER_CREATE,
+		BUFFER_UPLOAD,
+		FRAME_END,
+		
+		COUNT
+	};
+	
+	struct RecordHeader {
+		RecordType type;
+		uint32_t size; // Payload bytes after this header, padding included.
+	};
+	
+	// RenderState with the pointers swapped for uids. Draws only store the fields that changed since the previous draw.
+	struct CapturedRenderState {
+		uint64_t vertex_shader;
+		uint64_t pixel_shader;
+		uint64_t canvas;
+		uint64_t texture0;
+		uint64_t texture1;
+		uint64_t buffers[max_bound_buffers];
+		
+		Rect viewport;
+		mat4 projection;
+		
+		uint32_t blend_mode;
+		uint8_t depth_test;
+		uint8_t depth_write;
+		
+		Rect scissor;
+		
+		uint64_t texture2;
+		uint32_t instance_count;
+		vec4 constants[max_shader_constants];
+	};
+	
+	struct CapturedField {
+		uint32_t offset;
+		uint32_t size;
+	};
+	
+	#define CAPTURED_FIELD(name) { offsetof(CapturedRenderState, name), sizeof(CapturedRenderState::name) }
+	
+	// When RenderState gets a new member, it needs a field here too. Add new fields at the end and bump trace_version.
+	static const CapturedField captured_render_state_fields[] = {
+		CAPTURED_FIELD(vertex_shader),
+		CAPTURED_FIELD(pixel_shader),
+		CAPTURED_FIELD(canvas),
+		CAPTURED_FIELD(texture0),
+		CAPTURED_FIELD(texture1),
+		CAPTURED_FIELD(buffers),
+		CAPTURED_FIELD(viewport),
+		CAPTURED_FIELD(projection),
+		CAPTURED_FIELD(blend_mode),
+		CAPTURED_FIELD(depth_test),
+		CAPTURED_FIELD(depth_write),
+		CAPTURED_FIELD(scissor),
+		CAPTURED_FIELD(texture2),
+		CAPTURED_FIELD(instance_count),
+		CAPTURED_FIELD(constants),
+	};
+	
+	#undef CAPTURED_FIELD
+	
+	constexpr int captured_field_count = sizeof(captured_render_state_fields) / sizeof(captured_render_state_fields[0]);
+	static_assert(captured_field_count <= 32, "The changed field mask is a uint32_t.");
+	
+	static uint64_t uid_of(Resource* resource) {
+		return resource ? resource->uid : 0;
+	}
+	
+	//
+	// Capture
+	//
+	
+	struct Capture {
+		FILE* file = nullptr;
+		
+		// Each record is built here first, since its header needs the payload size.
+		uint8_t* payload = nullptr;
+		uint32_t payload_size = 0;
+		uint32_t payload_capacity = 0;
+		
+		CapturedRenderState last_state;
+		bool last_state_valid = false;
+		
+		std::chrono::steady_clock::time_point last_frame_end;
+	};
+	
+	static Capture capture;
+	
+	static void put(const void* data, uint32_t size) {
+		if (capture.payload_size + size > capture.payload_capacity) {
+			uint32_t capacity = capture.payload_capacity ? capture.payload_capacity * 2 : 4096;
+			while (capacity < capture.payload_size + size) capacity *= 2;
+			
+			capture.payload = (uint8_t*) realloc(capture.payload, capacity);
+			paintbox_assert(capture.payload);
+			capture.payload_capacity = capacity;
+		}
+		
+		memcpy(capture.payload + capture.payload_size, data, size);
+		capture.payload_size += size;
+	}
+	
+	template <typename T>
+	static void put_value(T value) {
+		put(&value, sizeof(value));
+	}
+	
+	static void record_begin() {
+		capture.payload_size = 0;
+	}
+	
+	static void record_end(RecordType type) {
+		static const uint8_t zeroes[8] = {};
+		put(zeroes, (8 - capture.payload_size % 8) % 8);
+		
+		RecordHeader header = {type, capture.payload_size};
+		fwrite(&header, sizeof(header), 1, capture.file);
+		fwrite(capture.payload, 1, capture.payload_size, capture.file);
+	}
+	
+	bool capture_begin(const char* path) {
+		paintbox_assert_log(!capture.file, "capture_begin() was called while another capture was running.");
+		
+		capture.file = fopen(path, "wb");
+		if (!capture.file) {
+			paintbox_log("Failed to create trace file '%s'.", path);
+			return false;
+		}
+		
+		// Traces are written in big sequential chunks. This keeps us from hitting the disk for every draw.
+		setvbuf(capture.file, nullptr, _IOFBF, 1 << 20);
+		
+		TraceHeader header = {trace_magic, trace_version};
+		fwrite(&header, sizeof(header), 1, capture.file);
+		
+		capture.last_state_valid = false;
+		capture.last_frame_end = std::chrono::steady_clock::now();
+		return true;
+	}
+	
+	void capture_frame_end() {
+		if (!capture.file) return;
+		
+		auto now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - capture.last_frame_end).count();
+		capture.last_frame_end = now;
+		
+		record_begin();
+		put_value(seconds);
+		record_end(RecordType::FRAME_END);
+	}
+	
+	void capture_end() {
+		if (!capture.file) return;
+		
+		fclose(capture.file);
+		capture.file = nullptr;
+		
+		free(capture.payload);
+		capture.payload = nullptr;
+		capture.payload_size = 0;
+		capture.payload_capacity = 0;
+	}
+	
+	bool capture_is_active() {
+		return capture.file != nullptr;
+	}
+	
+	void capture_shader_create(Shader* shader, ShaderLanguage language, ShaderType type, const char* shader_source_code) {
+		if (!capture.file || !shader) return;
+		
+		uint32_t length = (uint32_t) strlen(shader_source_code);
+		
+		record_begin();
+		put_value(shader->uid);
+		put_value((uint32_t) language);
+		put_value((uint32_t) type);
+		put_value(length);
+		put(shader_source_code, length + 1);
+		record_end(RecordType::SHADER_CREATE);
+	}
+	
+	void capture_texture_create(Texture* texture, void* image_data) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(texture->uid);
+		put_value((uint32_t) texture->format);
+		put_value(texture->width);
+		put_value(texture->height);
+		put_value((uint32_t) (image_data != nullptr));
+		if (image_data) put(image_data, texture_level_size(texture->format, texture->width, texture->height));
+		record_end(RecordType::TEXTURE_CREATE);
+	}
+	
+	void capture_texture_update(Texture* texture, int32_t x, int32_t y, int32_t width, int32_t height, void* data, int32_t data_row_length) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(texture->uid);
+		put_value(x);
+		put_value(y);
+		put_value(width);
+		put_value(height);
+		
+		// Always stored tightly packed, so the replay doesn't have to carry the rest of the source image around.
+		uint32_t row_size = texture_level_size(texture->format, width, 1);
+		uint32_t source_stride = data_row_length ? texture_level_size(texture->format, data_row_length, 1) : row_size;
+		for (int32_t row = 0; row < height; row += 1) {
+			put((uint8_t*) data + row * source_stride, row_size);
+		}
+		
+		record_end(RecordType::TEXTURE_UPDATE);
+	}
+	
+	void capture_texture_allocate(Texture* texture) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(texture->uid);
+		put_value((uint32_t) texture->format);
+		put_value(texture->width);
+		put_value(texture->height);
+		put_value(texture->mip_count);
+		record_end(RecordType::TEXTURE_ALLOCATE);
+	}
+	
+	void capture_texture_upload_mip(Texture* texture, int32_t level, void* data, uint32_t size) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(texture->uid);
+		put_value(level);
+		put_value(size);
+		put_value((uint32_t) 0); // Keeps the data 8 byte aligned.
+		put(data, size);
+		record_end(RecordType::TEXTURE_UPLOAD_MIP);
+	}
+	
+	void capture_canvas_create(Canvas* canvas) {
+		if (!capture.file || !canvas) return;
+		
+		// The canvas texture gets a new uid in the replay too, so we store the one it had here and map it on the other side.
+		record_begin();
+		put_value(canvas->uid);
+		put_value(canvas->texture->uid);
+		put_value((uint32_t) canvas->format);
+		put_value(canvas->width);
+		put_value(canvas->height);
+		record_end(RecordType::CANVAS_CREATE);
+	}
+	
+	void capture_canvas_clear(Canvas* canvas, vec4 color, float depth, Rect rect) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(uid_of(canvas));
+		put_value(color);
+		put_value(depth);
+		put_value(rect);
+		record_end(RecordType::CANVAS_CLEAR);
+	}
+	
+	void capture_canvas_blit(Canvas* source, Canvas* destination, Rect rect) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(uid_of(source));
+		put_value(uid_of(destination));
+		put_value(rect);
+		record_end(RecordType::CANVAS_BLIT);
+	}
+	
+	void capture_mesh_create(Mesh* mesh, Vertex vertices[], void* indices, uint32_t index_size) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(mesh->uid);
+		put_value((uint32_t) mesh->vertex_count);
+		put_value((uint32_t) mesh->index_count);
+		put_value((uint32_t) (vertices != nullptr));
+		put_value(index_size); // Also keeps the data 8 byte aligned.
+		if (vertices) {
+			put(vertices, mesh->vertex_count * sizeof(Vertex));
+			put(indices, mesh->index_count * index_size);
+		}
+		record_end(RecordType::MESH_CREATE);
+	}
+	
+	void capture_mesh_upload(Mesh* mesh, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[]) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(mesh->uid);
+		put_value(vertex_count);
+		put_value(index_count);
+		put_value((uint32_t) 0); // Keeps the data 8 byte aligned.
+		put(vertices, vertex_count * sizeof(Vertex));
+		put(indices, index_count * sizeof(uint32_t));
+		record_end(RecordType::MESH_UPLOAD);
+	}
+	
+	void capture_mesh_render(Mesh* mesh, RenderState* state, int32_t index_count, uint32_t first_index, double time) {
+		if (!capture.file) return;
+		
+		CapturedRenderState captured;
+		memset(&captured, 0, sizeof(captured)); // Padding is compared too, so it must be zero.
+		captured.vertex_shader = uid_of(state->vertex_shader);
+		captured.pixel_shader = uid_of(state->pixel_shader);
+		captured.canvas = uid_of(state->canvas);
+		captured.texture0 = uid_of(state->texture0);
+		captured.texture1 = uid_of(state->texture1);
+		for (int i = 0; i < max_bound_buffers; i += 1) captured.buffers[i] = uid_of(state->buffers[i]);
+		captured.viewport = state->viewport;
+		captured.projection = state->projection;
+		captured.blend_mode = (uint32_t) state->blend_mode;
+		captured.depth_test = state->depth_test;
+		captured.depth_write = state->depth_write;
+		captured.scissor = state->scissor;
+		captured.texture2 = uid_of(state->texture2);
+		captured.instance_count = state->instance_count;
+		memcpy(captured.constants, state->constants, sizeof(captured.constants));
+		
+		uint32_t changed_mask = 0;
+		for (int i = 0; i < captured_field_count; i += 1) {
+			CapturedField field = captured_render_state_fields[i];
+			bool changed = !capture.last_state_valid || memcmp((uint8_t*) &captured + field.offset, (uint8_t*) &capture.last_state + field.offset, field.size) != 0;
+			if (changed) changed_mask |= 1u << i;
+		}
+		
+		record_begin();
+		put_value(mesh->uid);
+		put_value(time);
+		put_value(index_count);
+		put_value(first_index);
+		put_value(changed_mask);
+		for (int i = 0; i < captured_field_count; i += 1) {
+			CapturedField field = captured_render_state_fields[i];
+			if (changed_mask & (1u << i)) put((uint8_t*) &captured + field.offset, field.size);
+		}
+		record_end(RecordType::MESH_RENDER);
+		
+		capture.last_state = captured;
+		capture.last_state_valid = true;
+	}
+	
+	void capture_buffer_create(Buffer* buffer, void* data) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(buffer->uid);
+		put_value(buffer->size);
+		put_value((uint32_t) (data != nullptr));
+		if (data) put(data, buffer->size);
+		record_end(RecordType::BUFFER_CREATE);
+	}
+	
+	void capture_buffer_upload(Buffer* buffer, uint32_t offset, uint32_t size, void* data) {
+		if (!capture.file) return;
+		
+		record_begin();
+		put_value(buffer->uid);
+		put_value(offset);
+		put_value(size);
+		put_value((uint32_t) 0); // Keeps the data 8 byte aligned.
+		put(data, size);
+		record_end(RecordType::BUFFER_UPLOAD);
+	}
+	
+	//
+	// Replay
+	//
+	
+	struct ReplayImpl : Replay {
+		MappedFile file;
+		uint64_t cursor = 0;
+		
+		// Capture uid -> resource created by the replay.
+		Resource** resources = nullptr;
+		uint64_t resource_capacity = 0;
+		
+		CapturedRenderState state;
+	};
+	
+	static void replay_set_resource(ReplayImpl* replay, uint64_t uid, Resource* resource) {
+		if (uid >= replay->resource_capacity) {
+			uint64_t capacity = replay->resource_capacity ? replay->resource_capacity * 2 : 256;
+			while (capacity <= uid) capacity *= 2;
+			
+			replay->resources = (Resource**) realloc(replay->resources, capacity * sizeof(Resource*));
+			paintbox_assert(replay->resources);
+			memset(replay->resources + replay->resource_capacity, 0, (capacity - replay->resource_capacity) * sizeof(Resource*));
+			replay->resource_capacity = capacity;
+		}
+		
+		replay->resources[uid] = resource;
+	}
+	
+	template <typename T>
+	static T* replay_get_resource(ReplayImpl* replay, uint64_t uid) {
+		if (uid == 0) return nullptr;
+		
+		paintbox_assert_log(uid < replay->resource_capacity && replay->resources[uid], "The trace refers to resource %llu, which was created before the capture started.", (unsigned long long) uid);
+		return (T*) replay->resources[uid];
+	}
+	
+	// Reads the fields of a record payload in order. Blobs are returned as pointers into the mapped trace, without copying.
+	struct RecordReader {
+		uint8_t* cursor;
+		uint8_t* end;
+		
+		template <typename T>
+		T get() {
+			paintbox_assert(cursor + sizeof(T) <= end);
+			T value;
+			memcpy(&value, cursor, sizeof(T));
+			cursor += sizeof(T);
+			return value;
+		}
+		
+		void* take(uint64_t size) {
+			paintbox_assert(cursor + size <= end);
+			void* result = cursor;
+			cursor += size;
+			return result;
+		}
+	};
+	
+	Replay* replay_open(const char* path) {
+		MappedFile file;
+		if (!file_map(path, &file)) {
+			paintbox_log("Failed to open trace file '%s'.", path);
+			return nullptr;
+		}
+		
+		auto header = (TraceHeader*) file.data;
+		if (file.size < sizeof(TraceHeader) || header->magic != trace_magic || header->version != trace_version) {
+			paintbox_log("Failed to open trace file '%s': not a trace, or written by a different version.", path);
+			file_unmap(&file);
+			return nullptr;
+		}
+		
+		ReplayImpl* replay = new ReplayImpl; // #memory_cleanup
+		replay->file = file;
+		replay->cursor = sizeof(TraceHeader);
+		memset(&replay->state, 0, sizeof(replay->state));
+		
+		// Count the frames up front, so the caller knows how long the trace is. Only the record headers are touched.
+		uint64_t cursor = replay->cursor;
+		while (cursor + sizeof(RecordHeader) <= file.size) {
+			auto record = (RecordHeader*) ((uint8_t*) file.data + cursor);
+			if (record->type == RecordType::FRAME_END) replay->frame_count += 1;
+			cursor += sizeof(RecordHeader) + record->size;
+		}
+		
+		return replay;
+	}
+	
+	bool replay_frame(Replay* replay_base, ReplayFrameStats* stats) {
+		auto replay = (ReplayImpl*) replay_base;
+		auto file_data = (uint8_t*) replay->file.data;
+		
+		*stats = {};
+		stats->frame_index = replay->next_frame;
+		
+		auto start = std::chrono::steady_clock::now();
+		bool frame_done = false;
+		
+		while (!frame_done && replay->cursor + sizeof(RecordHeader) <= replay->file.size) {
+			auto record = (RecordHeader*) (file_data + replay->cursor);
+			replay->cursor += sizeof(RecordHeader);
+			
+			if (replay->cursor + record->size > replay->file.size) {
+				paintbox_log("Trace is truncated at byte %llu.", (unsigned long long) replay->cursor);
+				replay->cursor = replay->file.size;
+				break;
+			}
+			
+			RecordReader reader = {file_data + replay->cursor, file_data + replay->cursor + record->size};
+			replay->cursor += record->size;
+			
+			switch (record->type) {
+			  case RecordType::SHADER_CREATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					auto language = (ShaderLanguage) reader.get<uint32_t>();
+					auto type = (ShaderType) reader.get<uint32_t>();
+					uint32_t length = reader.get<uint32_t>();
+					auto source = (const char*) reader.take(length + 1);
+					
+					replay_set_resource(replay, uid, shader_create(language, type, source));
+				} break;
+			
+			  case RecordType::TEXTURE_CREATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					auto format = (TextureFormat) reader.get<uint32_t>();
+					int32_t width = reader.get<int32_t>();
+					int32_t height = reader.get<int32_t>();
+					bool has_data = reader.get<uint32_t>() != 0;
+					void* data = has_data ? reader.take(texture_level_size(format, width, height)) : nullptr;
+					
+					replay_set_resource(replay, uid, texture_create(format, width, height, data));
+				} break;
+			
+			  case RecordType::TEXTURE_UPDATE: {
+					auto texture = replay_get_resource<Texture>(replay, reader.get<uint64_t>());
+					int32_t x = reader.get<int32_t>();
+					int32_t y = reader.get<int32_t>();
+					int32_t width = reader.get<int32_t>();
+					int32_t height = reader.get<int32_t>();
+					void* data = reader.take(texture_level_size(texture->format, width, height));
+					
+					texture_update(texture, x, y, width, height, data);
+				} break;
+			
+			  case RecordType::TEXTURE_ALLOCATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					auto format = (TextureFormat) reader.get<uint32_t>();
+					int32_t width = reader.get<int32_t>();
+					int32_t height = reader.get<int32_t>();
+					int32_t mip_count = reader.get<int32_t>();
+					
+					replay_set_resource(replay, uid, texture_allocate(format, width, height, mip_count));
+				} break;
+			
+			  case RecordType::TEXTURE_UPLOAD_MIP: {
+					auto texture = replay_get_resource<Texture>(replay, reader.get<uint64_t>());
+					int32_t level = reader.get<int32_t>();
+					uint32_t size = reader.get<uint32_t>();
+					reader.get<uint32_t>();
+					void* data = reader.take(size);
+					
+					texture_upload_mip(texture, level, data, size);
+				} break;
+			
+			  case RecordType::CANVAS_CREATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					uint64_t texture_uid = reader.get<uint64_t>();
+					auto format = (TextureFormat) reader.get<uint32_t>();
+					int32_t width = reader.get<int32_t>();
+					int32_t height = reader.get<int32_t>();
+					
+					Canvas* canvas = canvas_create(format, width, height);
+					replay_set_resource(replay, uid, canvas);
+					replay_set_resource(replay, texture_uid, canvas ? canvas->texture : nullptr);
+				} break;
+			
+			  case RecordType::CANVAS_CLEAR: {
+					auto canvas = replay_get_resource<Canvas>(replay, reader.get<uint64_t>());
+					vec4 color = reader.get<vec4>();
+					float depth = reader.get<float>();
+					Rect rect = reader.get<Rect>();
+					
+					canvas_clear(canvas, color, depth, rect);
+				} break;
+			
+			  case RecordType::CANVAS_BLIT: {
+					auto source = replay_get_resource<Canvas>(replay, reader.get<uint64_t>());
+					auto destination = replay_get_resource<Canvas>(replay, reader.get<uint64_t>());
+					Rect rect = reader.get<Rect>();
+					
+					canvas_blit(source, destination, rect);
+				} break;
+			
+			  case RecordType::MESH_CREATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					uint32_t vertex_count = reader.get<uint32_t>();
+					uint32_t index_count = reader.get<uint32_t>();
+					bool has_data = reader.get<uint32_t>() != 0;
+					uint32_t index_size = reader.get<uint32_t>();
+					
+					Vertex* vertices = nullptr;
+					void* indices = nullptr;
+					if (has_data) {
+						vertices = (Vertex*) reader.take(vertex_count * sizeof(Vertex));
+						indices = reader.take(index_count * index_size);
+					}
+					
+					Mesh* mesh;
+					if (index_size == sizeof(uint16_t)) mesh = mesh_create_u16(vertex_count, index_count, vertices, (uint16_t*) indices);
+					else mesh = mesh_create(vertex_count, index_count, vertices, (uint32_t*) indices);
+					replay_set_resource(replay, uid, mesh);
+				} break;
+			
+			  case RecordType::MESH_UPLOAD: {
+					auto mesh = replay_get_resource<Mesh>(replay, reader.get<uint64_t>());
+					uint32_t vertex_count = reader.get<uint32_t>();
+					uint32_t index_count = reader.get<uint32_t>();
+					reader.get<uint32_t>();
+					auto vertices = (Vertex*) reader.take(vertex_count * sizeof(Vertex));
+					auto indices = (uint32_t*) reader.take(index_count * sizeof(uint32_t));
+					
+					mesh_upload(mesh, vertex_count, vertices, index_count, indices);
+				} break;
+			
+			  case RecordType::MESH_RENDER: {
+					auto mesh = replay_get_resource<Mesh>(replay, reader.get<uint64_t>());
+					double time = reader.get<double>();
+					int32_t index_count = reader.get<int32_t>();
+					uint32_t first_index = reader.get<uint32_t>();
+					uint32_t changed_mask = reader.get<uint32_t>();
+					
+					for (int i = 0; i < captured_field_count; i += 1) {
+						CapturedField field = captured_render_state_fields[i];
+						if (changed_mask & (1u << i)) memcpy((uint8_t*) &replay->state + field.offset, reader.take(field.size), field.size);
+					}
+					
+					CapturedRenderState* captured = &replay->state;
+					
+					RenderState state;
+					state.vertex_shader = replay_get_resource<Shader>(replay, captured->vertex_shader);
+					state.pixel_shader = replay_get_resource<Shader>(replay, captured->pixel_shader);
+					state.canvas = replay_get_resource<Canvas>(replay, captured->canvas);
+					state.texture0 = replay_get_resource<Texture>(replay, captured->texture0);
+					state.texture1 = replay_get_resource<Texture>(replay, captured->texture1);
+					for (int i = 0; i < max_bound_buffers; i += 1) state.buffers[i] = replay_get_resource<Buffer>(replay, captured->buffers[i]);
+					state.viewport = captured->viewport;
+					state.projection = captured->projection;
+					state.blend_mode = (BlendMode) captured->blend_mode;
+					state.depth_test = captured->depth_test != 0;
+					state.depth_write = captured->depth_write != 0;
+					state.scissor = captured->scissor;
+					state.texture2 = replay_get_resource<Texture>(replay, captured->texture2);
+					state.instance_count = captured->instance_count;
+					memcpy(state.constants, captured->constants, sizeof(state.constants));
+					
+					time_override(time);
+					mesh_render(mesh, &state, index_count, first_index);
+					time_override_clear();
+				} break;
+			
+			  case RecordType::BUFFER_CREATE: {
+					uint64_t uid = reader.get<uint64_t>();
+					uint32_t size = reader.get<uint32_t>();
+					bool has_data = reader.get<uint32_t>() != 0;
+					void* data = has_data ? reader.take(size) : nullptr;
+					
+					replay_set_resource(replay, uid, buffer_create(size, data));
+				} break;
+			
+			  case RecordType::BUFFER_UPLOAD: {
+					auto buffer = replay_get_resource<Buffer>(replay, reader.get<uint64_t>());
+					uint32_t offset = reader.get<uint32_t>();
+					uint32_t size = reader.get<uint32_t>();
+					reader.get<uint32_t>();
+					void* data = reader.take(size);
+					
+					buffer_upload(buffer, offset, size, data);
+				} break;
+			
+			  case RecordType::FRAME_END: {
+					stats->recorded_seconds = reader.get<double>();
+					frame_done = true;
+				} break;
+			
+			  default: {
+					// Written by a newer version. The size in the header lets us skip it.
+					paintbox_log("Skipping unknown trace record %u.", (uint32_t) record->type);
+				} break;
+			}
+			
+			if (record->type != RecordType::FRAME_END) stats->call_count += 1;
+		}
+		
+		stats->cpu_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		
+		if (!frame_done) return false;
+		replay->next_frame += 1;
+		return true;
+	}
+	
+	void replay_close(Replay* replay_base) {
+		auto replay = (ReplayImpl*) replay_base;
+		file_unmap(&replay->file);
+		free(replay->resources);
+		delete replay;
+	}
+
+}
\ No newline at end of file
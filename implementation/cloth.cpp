@@ -0,0 +1,485 @@
+#include "paintbox.h"
+
+#include <math.h>   // For sqrtf and powf.
+#include <string.h> // For memset.
+
+#if PAINTBOX_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Paintbox {
+	
+	// Batches with more constraints than this get split between the job threads, when the cloth has the threads to itself.
+	constexpr uint32_t cloth_constraints_per_job = 2048;
+	
+	// The coloring keeps the used colors of a particle in a mask, so this many batches per kind of constraint at most.
+	// A grid needs 8 or so for the stretch constraints and 4 for the bend ones.
+	constexpr int32_t cloth_max_colors = 64;
+	
+	static_assert(sizeof(vec4) == 4 * sizeof(float), "Particles are loaded and stored as 4 floats at a time.");
+	
+	struct ClothBatch {
+		uint32_t first = 0;
+		uint32_t count = 0;
+		bool bend = false;
+	};
+	
+	struct ClothImpl : Cloth {
+		// Positions keep the inverse mass in w, 0 for pinned particles, so a constraint gets everything it needs about a particle with a single load.
+		// Velocities keep 0 in w, so integrating never touches the masses.
+		int32_t particle_count = 0;
+		vec4* positions = nullptr;
+		vec4* previous_positions = nullptr;
+		vec4* velocities = nullptr;
+		
+		// Sorted by batch, and no two constraints of a batch share a particle, so a whole batch can be solved in any order, by any number of threads.
+		uint32_t constraint_count = 0;
+		uint32_t* constraint_a = nullptr;
+		uint32_t* constraint_b = nullptr;
+		float* rest_length = nullptr;
+		ClothBatch* batches = nullptr;
+		
+		vec4 color;
+		Vertex* mapped_vertices = nullptr; // Only during cloth_step.
+	};
+	
+	struct ClothConstraintList {
+		uint32_t count = 0;
+		uint32_t* a = nullptr;
+		uint32_t* b = nullptr;
+		float* rest_length = nullptr;
+	};
+	
+	static void cloth_add_constraint(ClothConstraintList* list, uint32_t a, uint32_t b, float rest_length) {
+		list->a[list->count] = a;
+		list->b[list->count] = b;
+		list->rest_length[list->count] = rest_length;
+		list->count += 1;
+	}
+	
+	// Greedy coloring: every constraint takes the first color that neither of its particles has yet. Then the constraints are copied into the
+	// cloth sorted by color, and every color becomes a batch. Creation order is kept within a batch, so neighbors stay close in memory.
+	static void cloth_add_batches(ClothImpl* cloth, ClothConstraintList* list, bool bend) {
+		uint64_t* used_colors = (uint64_t*) malloc(cloth->particle_count * sizeof(uint64_t));
+		uint8_t* colors = (uint8_t*) malloc(list->count);
+		paintbox_assert(used_colors && colors);
+		memset(used_colors, 0, cloth->particle_count * sizeof(uint64_t));
+		
+		uint32_t color_sizes[cloth_max_colors] = {};
+		int32_t color_count = 0;
+		
+		for (uint32_t i = 0; i < list->count; i += 1) {
+			uint64_t used = used_colors[list->a[i]] | used_colors[list->b[i]];
+			
+			int32_t color = 0;
+			while (used & ((uint64_t) 1 << color)) color += 1;
+			paintbox_assert(color < cloth_max_colors);
+			
+			used_colors[list->a[i]] |= (uint64_t) 1 << color;
+			used_colors[list->b[i]] |= (uint64_t) 1 << color;
+			colors[i] = (uint8_t) color;
+			color_sizes[color] += 1;
+			if (color + 1 > color_count) color_count = color + 1;
+		}
+		
+		uint32_t color_offsets[cloth_max_colors];
+		uint32_t offset = cloth->constraint_count;
+		for (int32_t color = 0; color < color_count; color += 1) {
+			ClothBatch* batch = &cloth->batches[cloth->batch_count++];
+			batch->first = offset;
+			batch->count = color_sizes[color];
+			batch->bend = bend;
+			
+			color_offsets[color] = offset;
+			offset += color_sizes[color];
+		}
+		
+		for (uint32_t i = 0; i < list->count; i += 1) {
+			uint32_t index = color_offsets[colors[i]]++;
+			cloth->constraint_a[index] = list->a[i];
+			cloth->constraint_b[index] = list->b[i];
+			cloth->rest_length[index] = list->rest_length[i];
+		}
+		cloth->constraint_count = offset;
+		
+		free(used_colors);
+		free(colors);
+	}
+	
+	static void cloth_write_vertices(ClothImpl* cloth, Vertex* vertices) {
+		float u_step = 1.0f / (cloth->columns - 1);
+		float v_step = 1.0f / (cloth->rows - 1);
+		
+		// Straight to the buffer, which is likely write combined memory, so each vertex gets written whole and in order, and never read back.
+		int32_t i = 0;
+		for (int32_t row = 0; row < cloth->rows; row += 1) {
+			for (int32_t column = 0; column < cloth->columns; column += 1) {
+				Vertex vertex;
+				vertex.position = cloth->positions[i].xyz;
+				vertex.color = cloth->color;
+				vertex.uv = vec2(column * u_step, 1 - row * v_step);
+				vertices[i] = vertex;
+				i += 1;
+			}
+		}
+	}
+	
+	Cloth* cloth_create(int32_t columns, int32_t rows, vec3 top_left, float spacing, vec4 color) {
+		paintbox_assert(columns >= 2 && rows >= 2 && spacing > 0);
+		
+		ClothImpl* cloth = new ClothImpl; // #memory_cleanup
+		cloth->columns = columns;
+		cloth->rows = rows;
+		cloth->color = color;
+		
+		int32_t particle_count = columns * rows;
+		cloth->particle_count = particle_count;
+		cloth->positions = new vec4[particle_count];
+		cloth->previous_positions = new vec4[particle_count];
+		cloth->velocities = new vec4[particle_count];
+		
+		for (int32_t i = 0; i < particle_count; i += 1) {
+			vec3 position = top_left + vec3((i % columns) * spacing, -(i / columns) * spacing, 0);
+			cloth->positions[i] = vec4(position, 1);
+			cloth->previous_positions[i] = vec4(position, 1);
+			cloth->velocities[i] = vec4(0, 0, 0, 0);
+		}
+		
+		// Neighbors and diagonal neighbors keep the cloth from stretching and shearing. Constraints that skip a particle keep it from folding too easily.
+		uint32_t stretch_capacity = 4 * particle_count;
+		uint32_t bend_capacity = 2 * particle_count;
+		
+		ClothConstraintList stretch;
+		stretch.a = (uint32_t*) malloc(stretch_capacity * sizeof(uint32_t));
+		stretch.b = (uint32_t*) malloc(stretch_capacity * sizeof(uint32_t));
+		stretch.rest_length = (float*) malloc(stretch_capacity * sizeof(float));
+		
+		ClothConstraintList bend;
+		bend.a = (uint32_t*) malloc(bend_capacity * sizeof(uint32_t));
+		bend.b = (uint32_t*) malloc(bend_capacity * sizeof(uint32_t));
+		bend.rest_length = (float*) malloc(bend_capacity * sizeof(float));
+		paintbox_assert(stretch.a && stretch.b && stretch.rest_length && bend.a && bend.b && bend.rest_length);
+		
+		float diagonal = spacing * sqrtf(2);
+		for (int32_t row = 0; row < rows; row += 1) {
+			for (int32_t column = 0; column < columns; column += 1) {
+				uint32_t i = row * columns + column;
+				bool right = column + 1 < columns;
+				bool down = row + 1 < rows;
+				
+				if (right) cloth_add_constraint(&stretch, i, i + 1, spacing);
+				if (down) cloth_add_constraint(&stretch, i, i + columns, spacing);
+				if (right && down) {
+					cloth_add_constraint(&stretch, i, i + columns + 1, diagonal);
+					cloth_add_constraint(&stretch, i + 1, i + columns, diagonal);
+				}
+				
+				if (column + 2 < columns) cloth_add_constraint(&bend, i, i + 2, 2 * spacing);
+				if (row + 2 < rows) cloth_add_constraint(&bend, i, i + 2 * columns, 2 * spacing);
+			}
+		}
+		
+		uint32_t constraint_count = stretch.count + bend.count;
+		cloth->constraint_a = new uint32_t[constraint_count];
+		cloth->constraint_b = new uint32_t[constraint_count];
+		cloth->rest_length = new float[constraint_count];
+		cloth->batches = new ClothBatch[2 * cloth_max_colors];
+		
+		cloth_add_batches(cloth, &stretch, false);
+		cloth_add_batches(cloth, &bend, true);
+		
+		free(stretch.a);
+		free(stretch.b);
+		free(stretch.rest_length);
+		free(bend.a);
+		free(bend.b);
+		free(bend.rest_length);
+		
+		// Two triangles per quad. The vertices change every step, so the mesh is created empty, which makes it a streaming one.
+		uint32_t index_count = (columns - 1) * (rows - 1) * 6;
+		uint32_t* indices = (uint32_t*) malloc(index_count * sizeof(uint32_t));
+		Vertex* vertices = (Vertex*) malloc(particle_count * sizeof(Vertex));
+		paintbox_assert(indices && vertices);
+		
+		uint32_t index = 0;
+		for (int32_t row = 0; row < rows - 1; row += 1) {
+			for (int32_t column = 0; column < columns - 1; column += 1) {
+				uint32_t corner = row * columns + column;
+				indices[index++] = corner;
+				indices[index++] = corner + columns;
+				indices[index++] = corner + columns + 1;
+				indices[index++] = corner;
+				indices[index++] = corner + columns + 1;
+				indices[index++] = corner + 1;
+			}
+		}
+		cloth_write_vertices(cloth, vertices);
+		
+		cloth->mesh = mesh_create(particle_count, index_count);
+		mesh_upload(cloth->mesh, particle_count, vertices, index_count, indices);
+		free(indices);
+		free(vertices);
+		
+		return cloth;
+	}
+	
+	void cloth_pin(Cloth* cloth, int32_t column, int32_t row, bool pinned) {
+		auto impl = (ClothImpl*) cloth;
+		paintbox_assert(column >= 0 && column < cloth->columns && row >= 0 && row < cloth->rows);
+		
+		int32_t i = row * cloth->columns + column;
+		impl->positions[i].w = pinned ? 0.0f : 1.0f;
+		impl->velocities[i] = vec4(0, 0, 0, 0);
+	}
+	
+	void cloth_set_position(Cloth* cloth, int32_t column, int32_t row, vec3 position) {
+		auto impl = (ClothImpl*) cloth;
+		paintbox_assert(column >= 0 && column < cloth->columns && row >= 0 && row < cloth->rows);
+		
+		// A teleport, not a push: the particle doesn't pick up any velocity from it.
+		int32_t i = row * cloth->columns + column;
+		impl->positions[i].xyz = position;
+		impl->previous_positions[i] = impl->positions[i];
+		impl->velocities[i] = vec4(0, 0, 0, 0);
+	}
+	
+	vec3 cloth_get_position(Cloth* cloth, int32_t column, int32_t row) {
+		auto impl = (ClothImpl*) cloth;
+		paintbox_assert(column >= 0 && column < cloth->columns && row >= 0 && row < cloth->rows);
+		
+		return impl->positions[row * cloth->columns + column].xyz;
+	}
+	
+	// Applies damping and acceleration, and moves every particle by its velocity. Pinned particles have no velocity.
+	static void cloth_integrate(ClothImpl* cloth, float seconds) {
+		float keep = 1 - cloth->damping * seconds;
+		if (keep < 0) keep = 0;
+		if (keep > 1) keep = 1;
+		
+		vec3 velocity_change = cloth->acceleration * seconds;
+		
+		#if PAINTBOX_SSE2
+		const __m128 keep4 = _mm_set1_ps(keep);
+		const __m128 seconds4 = _mm_set1_ps(seconds);
+		const __m128 change = _mm_setr_ps(velocity_change.x, velocity_change.y, velocity_change.z, 0);
+		
+		for (int32_t i = 0; i < cloth->particle_count; i += 1) {
+			__m128 position = _mm_loadu_ps(&cloth->positions[i].x);
+			__m128 inverse_mass = _mm_shuffle_ps(position, position, _MM_SHUFFLE(3, 3, 3, 3));
+			
+			__m128 velocity = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&cloth->velocities[i].x), keep4), change);
+			velocity = _mm_and_ps(velocity, _mm_cmpgt_ps(inverse_mass, _mm_setzero_ps()));
+			
+			_mm_storeu_ps(&cloth->previous_positions[i].x, position);
+			_mm_storeu_ps(&cloth->positions[i].x, _mm_add_ps(position, _mm_mul_ps(velocity, seconds4)));
+			_mm_storeu_ps(&cloth->velocities[i].x, velocity);
+		}
+		#else
+		for (int32_t i = 0; i < cloth->particle_count; i += 1) {
+			vec4* position = &cloth->positions[i];
+			vec4* velocity = &cloth->velocities[i];
+			
+			if (position->w > 0) {
+				velocity->x = velocity->x * keep + velocity_change.x;
+				velocity->y = velocity->y * keep + velocity_change.y;
+				velocity->z = velocity->z * keep + velocity_change.z;
+			} else {
+				*velocity = vec4(0, 0, 0, 0);
+			}
+			
+			cloth->previous_positions[i] = *position;
+			position->x += velocity->x * seconds;
+			position->y += velocity->y * seconds;
+			position->z += velocity->z * seconds;
+		}
+		#endif
+	}
+	
+	// Moves both ends of a constraint towards its rest length, each one in proportion to its inverse mass. Same math as the SSE path, in the same order.
+	static void cloth_solve_constraint(ClothImpl* cloth, uint32_t i, float stiffness) {
+		vec4* a = &cloth->positions[cloth->constraint_a[i]];
+		vec4* b = &cloth->positions[cloth->constraint_b[i]];
+		
+		float dx = b->x - a->x;
+		float dy = b->y - a->y;
+		float dz = b->z - a->z;
+		float length = sqrtf(dx * dx + dy * dy + dz * dz);
+		float denominator = (a->w + b->w) * length;
+		
+		// Both ends pinned, or both in the same spot, with no direction to push them apart.
+		if (!(denominator > 1e-12f)) return;
+		
+		float s = stiffness * (length - cloth->rest_length[i]) / denominator;
+		float sa = a->w * s;
+		float sb = b->w * s;
+		
+		a->x += sa * dx;
+		a->y += sa * dy;
+		a->z += sa * dz;
+		b->x -= sb * dx;
+		b->y -= sb * dy;
+		b->z -= sb * dz;
+	}
+	
+	static void cloth_solve(ClothImpl* cloth, uint32_t first, uint32_t end, float stiffness) {
+		uint32_t i = first;
+		
+		#if PAINTBOX_SSE2
+		// 4 constraints at a time: both ends of each are loaded whole, and transposed so every register holds one coordinate of 4 particles.
+		// Within a batch the particles are all different, so the stores never collide.
+		const uint32_t* ca = cloth->constraint_a;
+		const uint32_t* cb = cloth->constraint_b;
+		float* p = &cloth->positions[0].x;
+		
+		for (; i + 4 <= end; i += 4) {
+			__m128 ax = _mm_loadu_ps(p + 4 * ca[i + 0]);
+			__m128 ay = _mm_loadu_ps(p + 4 * ca[i + 1]);
+			__m128 az = _mm_loadu_ps(p + 4 * ca[i + 2]);
+			__m128 aw = _mm_loadu_ps(p + 4 * ca[i + 3]);
+			__m128 bx = _mm_loadu_ps(p + 4 * cb[i + 0]);
+			__m128 by = _mm_loadu_ps(p + 4 * cb[i + 1]);
+			__m128 bz = _mm_loadu_ps(p + 4 * cb[i + 2]);
+			__m128 bw = _mm_loadu_ps(p + 4 * cb[i + 3]);
+			_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+			_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+			
+			__m128 dx = _mm_sub_ps(bx, ax);
+			__m128 dy = _mm_sub_ps(by, ay);
+			__m128 dz = _mm_sub_ps(bz, az);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			
+			__m128 denominator = _mm_mul_ps(_mm_add_ps(aw, bw), length);
+			__m128 valid = _mm_cmpgt_ps(denominator, _mm_set1_ps(1e-12f));
+			
+			// Invalid lanes divide by zero, and the mask turns whatever that gives into 0.
+			__m128 s = _mm_div_ps(_mm_mul_ps(_mm_set1_ps(stiffness), _mm_sub_ps(length, _mm_loadu_ps(cloth->rest_length + i))), denominator);
+			s = _mm_and_ps(s, valid);
+			__m128 sa = _mm_mul_ps(aw, s);
+			__m128 sb = _mm_mul_ps(bw, s);
+			
+			ax = _mm_add_ps(ax, _mm_mul_ps(sa, dx));
+			ay = _mm_add_ps(ay, _mm_mul_ps(sa, dy));
+			az = _mm_add_ps(az, _mm_mul_ps(sa, dz));
+			bx = _mm_sub_ps(bx, _mm_mul_ps(sb, dx));
+			by = _mm_sub_ps(by, _mm_mul_ps(sb, dy));
+			bz = _mm_sub_ps(bz, _mm_mul_ps(sb, dz));
+			
+			_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+			_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+			_mm_storeu_ps(p + 4 * ca[i + 0], ax);
+			_mm_storeu_ps(p + 4 * ca[i + 1], ay);
+			_mm_storeu_ps(p + 4 * ca[i + 2], az);
+			_mm_storeu_ps(p + 4 * ca[i + 3], aw);
+			_mm_storeu_ps(p + 4 * cb[i + 0], bx);
+			_mm_storeu_ps(p + 4 * cb[i + 1], by);
+			_mm_storeu_ps(p + 4 * cb[i + 2], bz);
+			_mm_storeu_ps(p + 4 * cb[i + 3], bw);
+		}
+		#endif
+		
+		for (; i < end; i += 1) cloth_solve_constraint(cloth, i, stiffness);
+	}
+	
+	struct ClothBatchJob {
+		ClothImpl* cloth;
+		ClothBatch batch;
+		float stiffness;
+	};
+	
+	static void solve_batch_part(int32_t index, void* user_data) {
+		auto job = (ClothBatchJob*) user_data;
+		
+		uint32_t first = job->batch.first + index * cloth_constraints_per_job;
+		uint32_t end = job->batch.first + job->batch.count;
+		if (end > first + cloth_constraints_per_job) end = first + cloth_constraints_per_job;
+		
+		cloth_solve(job->cloth, first, end, job->stiffness);
+	}
+	
+	// Velocities come from how far the particles actually went, constraints included. Inverse masses cancel out, so w stays 0.
+	static void cloth_update_velocities(ClothImpl* cloth, float seconds) {
+		float inverse_seconds = 1 / seconds;
+		
+		for (int32_t i = 0; i < cloth->particle_count; i += 1) {
+			#if PAINTBOX_SSE2
+			__m128 moved = _mm_sub_ps(_mm_loadu_ps(&cloth->positions[i].x), _mm_loadu_ps(&cloth->previous_positions[i].x));
+			_mm_storeu_ps(&cloth->velocities[i].x, _mm_mul_ps(moved, _mm_set1_ps(inverse_seconds)));
+			#else
+			vec4 position = cloth->positions[i];
+			vec4 previous = cloth->previous_positions[i];
+			cloth->velocities[i] = vec4((position.x - previous.x) * inverse_seconds, (position.y - previous.y) * inverse_seconds, (position.z - previous.z) * inverse_seconds, 0);
+			#endif
+		}
+	}
+	
+	// Stiffness is applied at every solve, so on its own it'd compound into something stiffer the more solves there are.
+	// This is the per solve value that adds up to 'stiffness' over all of them.
+	static float cloth_solve_stiffness(float stiffness, int32_t solve_count) {
+		if (stiffness >= 1) return 1;
+		if (stiffness <= 0) return 0;
+		return 1 - powf(1 - stiffness, 1.0f / solve_count);
+	}
+	
+	struct ClothStep {
+		Cloth** cloths;
+		float seconds;
+	};
+	
+	static void step_cloth(int32_t index, void* user_data) {
+		auto step = (ClothStep*) user_data;
+		auto cloth = (ClothImpl*) step->cloths[index];
+		
+		int32_t substeps = cloth->substeps > 0 ? cloth->substeps : 1;
+		int32_t iterations = cloth->iterations > 0 ? cloth->iterations : 1;
+		float seconds = step->seconds / substeps;
+		
+		float stretch_stiffness = cloth_solve_stiffness(cloth->stretch_stiffness, substeps * iterations);
+		float bend_stiffness = cloth_solve_stiffness(cloth->bend_stiffness, substeps * iterations);
+		
+		for (int32_t substep = 0; substep < substeps; substep += 1) {
+			cloth_integrate(cloth, seconds);
+			
+			for (int32_t iteration = 0; iteration < iterations; iteration += 1) {
+				for (int32_t i = 0; i < cloth->batch_count; i += 1) {
+					ClothBatch batch = cloth->batches[i];
+					float stiffness = batch.bend ? bend_stiffness : stretch_stiffness;
+					if (stiffness == 0) continue;
+					
+					// When every thread already has a cloth of its own, this just runs serially.
+					if (batch.count > cloth_constraints_per_job) {
+						ClothBatchJob job = {cloth, batch, stiffness};
+						int32_t part_count = (int32_t) ((batch.count + cloth_constraints_per_job - 1) / cloth_constraints_per_job);
+						parallel_for(part_count, solve_batch_part, &job);
+					} else {
+						cloth_solve(cloth, batch.first, batch.first + batch.count, stiffness);
+					}
+				}
+			}
+			
+			cloth_update_velocities(cloth, seconds);
+		}
+		
+		cloth_write_vertices(cloth, cloth->mapped_vertices);
+	}
+	
+	void cloth_step(Cloth* cloths[], int32_t cloth_count, float seconds) {
+		paintbox_assert(cloth_count >= 0);
+		if (cloth_count == 0 || !(seconds > 0)) return;
+		
+		// Mapping has to happen on this thread, but the jobs can write into the mapped memory from anywhere.
+		for (int32_t i = 0; i < cloth_count; i += 1) {
+			auto cloth = (ClothImpl*) cloths[i];
+			cloth->mapped_vertices = mesh_map_vertices(cloth->mesh);
+		}
+		
+		ClothStep step = {cloths, seconds};
+		parallel_for(cloth_count, step_cloth, &step);
+		
+		for (int32_t i = 0; i < cloth_count; i += 1) {
+			auto cloth = (ClothImpl*) cloths[i];
+			mesh_unmap_vertices(cloth->mesh);
+			cloth->mapped_vertices = nullptr;
+		}
+	}
+
+}
\ No newline at end of file
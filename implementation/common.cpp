@@ -1,5 +1,16 @@
 #include "paintbox.h"
 
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
 namespace Paintbox {
 	
 	static const char* next_resource_name;
@@ -37,4 +48,72 @@ namespace Paintbox {
 		next_resource_info_set = true;
 	}
 	
+	//
+	// Files
+	//
+
+#ifdef _WIN32
+	
+	bool file_map(const char* path, MappedFile* file) {
+		*file = {};
+		
+		HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) return false;
+		
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+			CloseHandle(handle);
+			return false;
+		}
+		
+		HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(handle); // The mapping keeps the file open.
+		if (!mapping) return false;
+		
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // The view keeps the mapping alive.
+		if (!data) return false;
+		
+		file->data = data;
+		file->size = (uint64_t) size.QuadPart;
+		return true;
+	}
+	
+	void file_unmap(MappedFile* file) {
+		if (file->data) UnmapViewOfFile(file->data);
+		*file = {};
+	}
+
+#else
+	
+	bool file_map(const char* path, MappedFile* file) {
+		*file = {};
+		
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) return false;
+		
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		
+		void* data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // The mapping keeps the file open.
+		if (data == MAP_FAILED) return false;
+		
+		madvise(data, (size_t) info.st_size, MADV_SEQUENTIAL);
+		
+		file->data = data;
+		file->size = (uint64_t) info.st_size;
+		return true;
+	}
+	
+	void file_unmap(MappedFile* file) {
+		if (file->data) munmap(file->data, (size_t) file->size);
+		*file = {};
+	}
+
+#endif
+	
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "paintbox.h"
+
+#include <math.h>
+
+namespace Paintbox {
+	
+	// Damage is kept in whole pixels, with max exclusive, so overlap tests and merges are exact.
+	struct DamageRect {
+		int32_t min_x, min_y;
+		int32_t max_x, max_y;
+	};
+	
+	struct DamageTrackerImpl : DamageTracker {
+		DamageRect pending[max_damage_rects];
+		int32_t pending_count = 0;
+	};
+	
+	static DamageRect damage_rect_from_rect(Rect rect) {
+		// Rounded outwards, so every pixel the rect touches is in.
+		DamageRect result;
+		result.min_x = (int32_t) floorf(rect.x);
+		result.min_y = (int32_t) floorf(rect.y);
+		result.max_x = (int32_t) ceilf(rect.x + rect.w);
+		result.max_y = (int32_t) ceilf(rect.y + rect.h);
+		return result;
+	}
+	
+	static Rect rect_from_damage_rect(DamageRect rect) {
+		return Rect(rect.min_x, rect.min_y, rect.max_x - rect.min_x, rect.max_y - rect.min_y);
+	}
+	
+	static bool damage_rect_is_empty(DamageRect rect) {
+		return rect.min_x >= rect.max_x || rect.min_y >= rect.max_y;
+	}
+	
+	static int64_t damage_rect_area(DamageRect rect) {
+		return (int64_t) (rect.max_x - rect.min_x) * (rect.max_y - rect.min_y);
+	}
+	
+	static DamageRect damage_rect_union(DamageRect a, DamageRect b) {
+		DamageRect result;
+		result.min_x = a.min_x < b.min_x ? a.min_x : b.min_x;
+		result.min_y = a.min_y < b.min_y ? a.min_y : b.min_y;
+		result.max_x = a.max_x > b.max_x ? a.max_x : b.max_x;
+		result.max_y = a.max_y > b.max_y ? a.max_y : b.max_y;
+		return result;
+	}
+	
+	static DamageRect damage_rect_intersection(DamageRect a, DamageRect b) {
+		DamageRect result;
+		result.min_x = a.min_x > b.min_x ? a.min_x : b.min_x;
+		result.min_y = a.min_y > b.min_y ? a.min_y : b.min_y;
+		result.max_x = a.max_x < b.max_x ? a.max_x : b.max_x;
+		result.max_y = a.max_y < b.max_y ? a.max_y : b.max_y;
+		return result;
+	}
+	
+	// Rects that only share an edge or a corner count too. Their bounding box can cover pixels neither of them had, but redrawing
+	// a few extra pixels is cheaper than one more scissored pass.
+	static bool damage_rects_touch(DamageRect a, DamageRect b) {
+		return a.min_x <= b.max_x && b.min_x <= a.max_x && a.min_y <= b.max_y && b.min_y <= a.max_y;
+	}
+	
+	DamageTracker* damage_tracker_create(TextureFormat format, int32_t width, int32_t height) {
+		Canvas* canvas = canvas_create(format, width, height);
+		if (!canvas) return nullptr;
+		
+		DamageTrackerImpl* tracker = new DamageTrackerImpl; // #memory_cleanup
+		tracker->canvas = canvas;
+		damage_add_all(tracker);
+		return tracker;
+	}
+	
+	void damage_add(DamageTracker* tracker, Rect rect) {
+		auto impl = (DamageTrackerImpl*) tracker;
+		
+		DamageRect canvas_rect = {0, 0, tracker->canvas->width, tracker->canvas->height};
+		DamageRect damage = damage_rect_intersection(damage_rect_from_rect(rect), canvas_rect);
+		if (damage_rect_is_empty(damage)) return;
+		
+		// Every merge takes a rect out of the list, so this ends.
+		while (true) {
+			// Whatever the new rect touches gets swallowed, so the pending rects never overlap.
+			bool merged = false;
+			for (int32_t i = 0; i < impl->pending_count; i += 1) {
+				if (damage_rects_touch(impl->pending[i], damage)) {
+					damage = damage_rect_union(impl->pending[i], damage);
+					impl->pending[i] = impl->pending[impl->pending_count - 1];
+					impl->pending_count -= 1;
+					merged = true;
+					break;
+				}
+			}
+			if (merged) continue;
+			
+			if (impl->pending_count < max_damage_rects) {
+				impl->pending[impl->pending_count] = damage;
+				impl->pending_count += 1;
+				return;
+			}
+			
+			// Out of room: fold it into the rect where that redraws the fewest extra pixels.
+			int32_t best = 0;
+			int64_t best_cost = INT64_MAX;
+			for (int32_t i = 0; i < impl->pending_count; i += 1) {
+				int64_t cost = damage_rect_area(damage_rect_union(impl->pending[i], damage)) - damage_rect_area(impl->pending[i]) - damage_rect_area(damage);
+				if (cost < best_cost) {
+					best = i;
+					best_cost = cost;
+				}
+			}
+			
+			damage = damage_rect_union(impl->pending[best], damage);
+			impl->pending[best] = impl->pending[impl->pending_count - 1];
+			impl->pending_count -= 1;
+		}
+	}
+	
+	void damage_add_all(DamageTracker* tracker) {
+		auto impl = (DamageTrackerImpl*) tracker;
+		impl->pending[0] = {0, 0, tracker->canvas->width, tracker->canvas->height};
+		impl->pending_count = 1;
+	}
+	
+	bool damage_render(DamageTracker* tracker, DrawList* list, vec4 clear_color) {
+		auto impl = (DamageTrackerImpl*) tracker;
+		
+		DamageRect damage[max_damage_rects];
+		int32_t damage_count = impl->pending_count;
+		for (int32_t i = 0; i < damage_count; i += 1) {
+			damage[i] = impl->pending[i];
+			tracker->rects[i] = rect_from_damage_rect(damage[i]);
+		}
+		tracker->rect_count = damage_count;
+		impl->pending_count = 0;
+		
+		if (damage_count == 0) {
+			list->count = 0;
+			return false;
+		}
+		
+		draw_list_sort(list);
+		
+		// One pass per rect. A draw that touches several rects is sent once for each of them, but only ever fills the pixels inside.
+		for (int32_t i = 0; i < damage_count; i += 1) {
+			canvas_clear(tracker->canvas, clear_color, 1, tracker->rects[i]);
+			
+			for (uint32_t j = 0; j < list->count; j += 1) {
+				DrawCommand* command = &list->commands[j];
+				
+				Rect bounds = command->bounds;
+				if (bounds.w <= 0 || bounds.h <= 0) bounds = command->state.viewport;
+				
+				DamageRect clip = damage_rect_intersection(damage[i], damage_rect_from_rect(bounds));
+				Rect scissor = command->state.scissor;
+				if (scissor.w > 0 && scissor.h > 0) clip = damage_rect_intersection(clip, damage_rect_from_rect(scissor));
+				if (damage_rect_is_empty(clip)) continue;
+				
+				RenderState state = command->state;
+				state.canvas = tracker->canvas;
+				state.scissor = rect_from_damage_rect(clip);
+				mesh_render(command->mesh, &state, command->index_count, command->first_index);
+			}
+		}
+		
+		list->count = 0;
+		return true;
+	}
+	
+	void damage_present(DamageTracker* tracker, Canvas* destination, bool damaged_only) {
+		if (!damaged_only) {
+			canvas_blit(tracker->canvas, destination, Rect(0, 0, tracker->canvas->width, tracker->canvas->height));
+			return;
+		}
+		
+		for (int32_t i = 0; i < tracker->rect_count; i += 1) {
+			canvas_blit(tracker->canvas, destination, tracker->rects[i]);
+		}
+	}
+
+}
\ No newline at end of file
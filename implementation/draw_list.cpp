@@ -0,0 +1,100 @@
+#include "paintbox.h"
+
+namespace Paintbox {
+	
+	DrawCommand* draw_list_add(DrawList* list, LayerMode mode, float depth, Mesh* mesh, RenderState* state, int32_t index_count, uint32_t first_index) {
+		if (list->count == list->capacity) {
+			uint32_t capacity = list->capacity ? list->capacity * 2 : 256;
+			list->commands = (DrawCommand*) realloc(list->commands, capacity * sizeof(DrawCommand));
+			paintbox_assert(list->commands);
+			list->capacity = capacity;
+		}
+		
+		DrawCommand* command = &list->commands[list->count];
+		command->mesh = mesh;
+		command->state = *state;
+		command->index_count = index_count;
+		command->first_index = first_index;
+		command->mode = mode;
+		command->depth = depth;
+		command->sequence = list->count;
+		command->bounds = {};
+		
+		// The layer mode decides the depth and blend state, whatever the caller had in there.
+		if (mode == LayerMode::OPAQUE) {
+			command->state.blend_mode = BlendMode::NONE;
+			command->state.depth_test = true;
+			command->state.depth_write = true;
+		} else {
+			if (command->state.blend_mode == BlendMode::NONE) command->state.blend_mode = BlendMode::ALPHA;
+			command->state.depth_test = true;
+			command->state.depth_write = false;
+		}
+		
+		list->count += 1;
+		return command;
+	}
+	
+	static int compare_draw_commands(const void* a_pointer, const void* b_pointer) {
+		auto a = (const DrawCommand*) a_pointer;
+		auto b = (const DrawCommand*) b_pointer;
+		
+		// Opaque before transparent.
+		if (a->mode != b->mode) return a->mode < b->mode ? -1 : 1;
+		
+		if (a->depth != b->depth) {
+			bool a_first = a->mode == LayerMode::OPAQUE ? a->depth < b->depth : a->depth > b->depth;
+			return a_first ? -1 : 1;
+		}
+		
+		// Opaque draws at the same depth are grouped by shader and texture to save state changes. Where they overlap, this order decides which one wins, so overlapping layers should get different depths.
+		if (a->mode == LayerMode::OPAQUE) {
+			if (a->state.pixel_shader != b->state.pixel_shader) return a->state.pixel_shader < b->state.pixel_shader ? -1 : 1;
+			if (a->state.texture0 != b->state.texture0) return a->state.texture0 < b->state.texture0 ? -1 : 1;
+		}
+		
+		// qsort isn't stable, so we keep the submission order ourselves.
+		return a->sequence < b->sequence ? -1 : (a->sequence > b->sequence ? 1 : 0);
+	}
+	
+	void draw_list_sort(DrawList* list) {
+		qsort(list->commands, list->count, sizeof(DrawCommand), compare_draw_commands);
+	}
+	
+	void draw_list_submit(DrawList* list) {
+		draw_list_sort(list);
+		
+		for (uint32_t i = 0; i < list->count; i += 1) {
+			DrawCommand* command = &list->commands[i];
+			mesh_render(command->mesh, &command->state, command->index_count, command->first_index);
+		}
+		
+		list->count = 0;
+	}
+	
+	void draw_list_merge(DrawList* list, DrawList* source) {
+		uint32_t count = list->count + source->count;
+		if (count > list->capacity) {
+			uint32_t capacity = list->capacity ? list->capacity : 256;
+			while (capacity < count) capacity *= 2;
+			list->commands = (DrawCommand*) realloc(list->commands, capacity * sizeof(DrawCommand));
+			paintbox_assert(list->commands);
+			list->capacity = capacity;
+		}
+		
+		for (uint32_t i = 0; i < source->count; i += 1) {
+			DrawCommand* command = &list->commands[list->count + i];
+			*command = source->commands[i];
+			command->sequence = list->count + i;
+		}
+		
+		list->count = count;
+		source->count = 0;
+	}
+	
+	void draw_list_free(DrawList* list) {
+		free(list->commands);
+		*list = {};
+	}
+
+}
\ No newline at end of file
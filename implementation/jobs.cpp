@@ -0,0 +1,183 @@
+#include "paintbox.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Paintbox {
+	
+	struct ParallelJob {
+		void (*proc)(int32_t index, void* user_data) = nullptr;
+		void* user_data = nullptr;
+		int32_t count = 0;
+		
+		std::atomic<int32_t> next_index {0};
+		std::atomic<int32_t> completed {0};
+		int32_t workers_inside = 0; // Protected by the job system mutex.
+	};
+	
+	struct AsyncJob {
+		void (*proc)(void* user_data) = nullptr;
+		void* user_data = nullptr;
+	};
+	
+	constexpr int32_t async_queue_capacity = 64;
+	
+	struct JobSystem {
+		std::mutex mutex;
+		std::condition_variable wake;     // Workers wait on this for new work.
+		std::condition_variable finished; // parallel_for waits on this for the workers to leave the job.
+		
+		std::mutex submit_mutex; // Only one parallel_for runs at a time.
+		
+		ParallelJob* current_job = nullptr;
+		uint64_t generation = 0;
+		
+		// Fire-and-forget jobs, picked up by whichever worker is free.
+		AsyncJob async_queue[async_queue_capacity];
+		int32_t async_first = 0;
+		int32_t async_count = 0;
+		
+		int32_t worker_count = 0;
+	};
+	
+	// The job system is never destroyed: the workers are detached and may still be waiting on its condition variables while the program exits.
+	static JobSystem* jobs;
+	static std::once_flag jobs_started;
+	
+	static thread_local bool inside_job;
+	
+	static void run_job_indices(ParallelJob* job) {
+		while (true) {
+			int32_t index = job->next_index.fetch_add(1);
+			if (index >= job->count) break;
+			
+			job->proc(index, job->user_data);
+			job->completed.fetch_add(1);
+		}
+	}
+	
+	static void worker_main() {
+		inside_job = true; // Workers never submit jobs of their own. Nested parallel_for calls just run serially.
+		
+		uint64_t seen_generation = 0;
+		
+		while (true) {
+			ParallelJob* job = nullptr;
+			AsyncJob async_job;
+			
+			{
+				std::unique_lock<std::mutex> lock(jobs->mutex);
+				jobs->wake.wait(lock, [&] { return jobs->generation != seen_generation || jobs->async_count > 0; });
+				
+				// parallel_for has a thread waiting on it, so it goes before the async jobs.
+				if (jobs->generation != seen_generation) {
+					seen_generation = jobs->generation;
+					job = jobs->current_job;
+					if (job) job->workers_inside += 1;
+				} else {
+					async_job = jobs->async_queue[jobs->async_first];
+					jobs->async_first = (jobs->async_first + 1) % async_queue_capacity;
+					jobs->async_count -= 1;
+				}
+			}
+			
+			if (async_job.proc) {
+				async_job.proc(async_job.user_data);
+				continue;
+			}
+			
+			if (!job) continue;
+			
+			run_job_indices(job);
+			
+			{
+				std::lock_guard<std::mutex> lock(jobs->mutex);
+				job->workers_inside -= 1;
+			}
+			jobs->finished.notify_all();
+		}
+	}
+	
+	static void start_workers() {
+		jobs = new JobSystem;
+		
+		int32_t hardware_threads = (int32_t) std::thread::hardware_concurrency();
+		jobs->worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0; // The thread calling parallel_for does its share of the work too.
+		
+		for (int32_t i = 0; i < jobs->worker_count; i += 1) {
+			std::thread(worker_main).detach();
+		}
+	}
+	
+	int32_t job_thread_count() {
+		std::call_once(jobs_started, start_workers);
+		return jobs->worker_count + 1;
+	}
+	
+	void job_run_async(void (*proc)(void* user_data), void* user_data) {
+		std::call_once(jobs_started, start_workers);
+		
+		bool queued = false;
+		if (jobs->worker_count > 0) {
+			std::lock_guard<std::mutex> lock(jobs->mutex);
+			if (jobs->async_count < async_queue_capacity) {
+				jobs->async_queue[(jobs->async_first + jobs->async_count) % async_queue_capacity] = {proc, user_data};
+				jobs->async_count += 1;
+				queued = true;
+			}
+		}
+		
+		if (queued) {
+			jobs->wake.notify_all();
+		} else {
+			// No workers, or they are all swamped. Doing the work right here is the best we can do.
+			proc(user_data);
+		}
+	}
+	
+	void parallel_for(int32_t count, void (*proc)(int32_t index, void* user_data), void* user_data) {
+		if (count <= 0) return;
+		
+		if (count == 1 || inside_job) {
+			for (int32_t i = 0; i < count; i += 1) proc(i, user_data);
+			return;
+		}
+		
+		std::call_once(jobs_started, start_workers);
+		
+		// Without workers there's nothing to hand out. This has to happen before taking submit_mutex, which isn't recursive, so that a
+		// nested parallel_for from one of these indices doesn't try to take it again. inside_job makes those nested calls run serially.
+		if (jobs->worker_count == 0) {
+			inside_job = true;
+			for (int32_t i = 0; i < count; i += 1) proc(i, user_data);
+			inside_job = false;
+			return;
+		}
+		
+		std::lock_guard<std::mutex> submit_lock(jobs->submit_mutex);
+		
+		ParallelJob job;
+		job.proc = proc;
+		job.user_data = user_data;
+		job.count = count;
+		
+		{
+			std::lock_guard<std::mutex> lock(jobs->mutex);
+			jobs->current_job = &job;
+			jobs->generation += 1;
+		}
+		jobs->wake.notify_all();
+		
+		inside_job = true;
+		run_job_indices(&job);
+		inside_job = false;
+		
+		// The job lives on our stack, so we can't leave until every worker that picked it up has let go of it.
+		std::unique_lock<std::mutex> lock(jobs->mutex);
+		jobs->current_job = nullptr;
+		jobs->finished.wait(lock, [&] { return job.workers_inside == 0 && job.completed.load() == job.count; });
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "paintbox.h"
+
+#include <math.h>   // For sqrtf.
+#include <string.h> // For memset and memcpy.
+
+#if PAINTBOX_SSE2
+#include <emmintrin.h>
+#endif
+
+// The bindings have to match light_buffer_binding and light_tile_buffer_binding.
+static const char* glsl_light_grid_source = R"glsl(
+struct PaintboxPointLight {
+	vec3 position;
+	float radius;
+	vec3 color;
+	float intensity;
+};
+
+layout (std430, binding = 2) readonly buffer PaintboxLights {
+	PaintboxPointLight paintbox_lights[];
+};
+
+layout (std430, binding = 3) readonly buffer PaintboxLightTiles {
+	uvec4 paintbox_light_grid; // Tile size, tiles x, tiles y, light count.
+	uint paintbox_light_tiles[];
+};
+
+vec3 light_grid_light(vec3 normal) {
+	uvec2 tile = uvec2(gl_FragCoord.xy) / paintbox_light_grid.x;
+	if (tile.x >= paintbox_light_grid.y || tile.y >= paintbox_light_grid.z) return vec3(0);
+
+	uint tile_index = tile.y * paintbox_light_grid.y + tile.x;
+	uint offset = paintbox_light_tiles[tile_index * 2];
+	uint count = paintbox_light_tiles[tile_index * 2 + 1];
+
+	vec3 result = vec3(0);
+	for (uint i = 0; i < count; i += 1) {
+		PaintboxPointLight light = paintbox_lights[paintbox_light_tiles[offset + i]];
+
+		vec3 delta = light.position - vec3(gl_FragCoord.xy, 0);
+		float falloff = clamp(1.0 - dot(delta.xy, delta.xy) / (light.radius * light.radius), 0.0, 1.0);
+		float lambert = max(dot(normal, normalize(delta)), 0.0);
+		result += light.color * (light.intensity * falloff * falloff * lambert);
+	}
+	return result;
+}
+)glsl";
+
+namespace Paintbox {
+	
+	static_assert(sizeof(PointLight) == 32, "PointLight is uploaded as it is, so it has to match the std430 layout of PaintboxPointLight.");
+	
+	// The tile buffer starts with a uvec4: tile size, tiles x, tiles y, light count.
+	constexpr int32_t light_grid_header_size = 4;
+	
+	struct LightGridImpl : LightGrid {
+		// Copies of what the binning reads, one array per field, padded to a multiple of 4 with lights of radius 0 that reach nothing.
+		float* light_x = nullptr;
+		float* light_y = nullptr;
+		float* light_radius = nullptr;
+		int32_t padded_light_count = 0;
+		
+		// Every tile gets room for max_lights_per_tile indices, so the rows can be binned at the same time. The lists are packed together afterwards.
+		uint16_t* tile_counts = nullptr;
+		uint32_t* tile_lights = nullptr;
+		int32_t* row_dropped_counts = nullptr;
+		
+		uint32_t* tile_data = nullptr; // What gets uploaded to tile_buffer.
+	};
+	
+	LightGrid* light_grid_create(int32_t width, int32_t height, int32_t max_lights) {
+		paintbox_assert(width > 0 && height > 0 && max_lights > 0);
+		
+		LightGridImpl* grid = new LightGridImpl; // #memory_cleanup
+		grid->width = width;
+		grid->height = height;
+		grid->tiles_x = (width + light_tile_size - 1) / light_tile_size;
+		grid->tiles_y = (height + light_tile_size - 1) / light_tile_size;
+		grid->max_lights = max_lights;
+		
+		int32_t tile_count = grid->tiles_x * grid->tiles_y;
+		int32_t padded_max_lights = (max_lights + 3) & ~3;
+		
+		grid->light_x = new float[padded_max_lights];
+		grid->light_y = new float[padded_max_lights];
+		grid->light_radius = new float[padded_max_lights];
+		
+		grid->tile_counts = new uint16_t[tile_count];
+		grid->tile_lights = new uint32_t[tile_count * max_lights_per_tile];
+		grid->row_dropped_counts = new int32_t[grid->tiles_y];
+		
+		uint32_t tile_data_capacity = light_grid_header_size + tile_count * 2 + tile_count * max_lights_per_tile;
+		grid->tile_data = new uint32_t[tile_data_capacity];
+		
+		grid->light_buffer = buffer_create(max_lights * sizeof(PointLight));
+		grid->tile_buffer = buffer_create(tile_data_capacity * sizeof(uint32_t));
+		
+		// Until the first update, every tile is empty.
+		light_grid_update(grid, nullptr, 0);
+		return grid;
+	}
+	
+	// Bins every light into one row of tiles. Rows don't share anything, so they run on different threads.
+	static void bin_tile_row(int32_t row, void* user_data) {
+		auto grid = (LightGridImpl*) user_data;
+		
+		int32_t tiles_x = grid->tiles_x;
+		uint16_t* counts = grid->tile_counts + row * tiles_x;
+		uint32_t* lists = grid->tile_lights + row * tiles_x * max_lights_per_tile;
+		memset(counts, 0, tiles_x * sizeof(uint16_t));
+		
+		const float tile_size = (float) light_tile_size;
+		const float row_center = (row + 0.5f) * tile_size;
+		const float last_tile = (float) (tiles_x - 1);
+		int32_t dropped = 0;
+		
+		for (int32_t i = 0; i < grid->padded_light_count; i += 4) {
+			// A light reaches the row if it's closer than its radius along y. Then what's left of the radius, sqrt(radius² - dy²), gives the
+			// columns it reaches, which makes the test exact for the circle instead of its bounding box.
+			int32_t mask = 0;
+			int32_t first_tiles[4];
+			int32_t last_tiles[4];
+			
+			#if PAINTBOX_SSE2
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 sign_bit = _mm_set1_ps(-0.0f);
+			
+			__m128 x = _mm_loadu_ps(grid->light_x + i);
+			__m128 y = _mm_loadu_ps(grid->light_y + i);
+			__m128 radius = _mm_loadu_ps(grid->light_radius + i);
+			
+			__m128 dy = _mm_andnot_ps(sign_bit, _mm_sub_ps(y, _mm_set1_ps(row_center)));
+			dy = _mm_max_ps(_mm_sub_ps(dy, _mm_set1_ps(tile_size * 0.5f)), zero);
+			
+			__m128 reach_squared = _mm_sub_ps(_mm_mul_ps(radius, radius), _mm_mul_ps(dy, dy));
+			mask = _mm_movemask_ps(_mm_cmpgt_ps(reach_squared, zero));
+			if (mask == 0) continue;
+			
+			__m128 reach = _mm_sqrt_ps(_mm_max_ps(reach_squared, zero));
+			__m128 first = _mm_mul_ps(_mm_sub_ps(x, reach), _mm_set1_ps(1.0f / tile_size));
+			__m128 last = _mm_mul_ps(_mm_add_ps(x, reach), _mm_set1_ps(1.0f / tile_size));
+			
+			// Lights entirely to the left or to the right of the canvas.
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(last, zero), _mm_cmple_ps(first, _mm_set1_ps(last_tile + 1)));
+			mask &= _mm_movemask_ps(inside);
+			if (mask == 0) continue;
+			
+			// Clamped to the canvas first, so the values are never negative and truncating is the same as rounding down.
+			first = _mm_min_ps(_mm_max_ps(first, zero), _mm_set1_ps(last_tile));
+			last = _mm_min_ps(_mm_max_ps(last, zero), _mm_set1_ps(last_tile));
+			_mm_storeu_si128((__m128i*) first_tiles, _mm_cvttps_epi32(first));
+			_mm_storeu_si128((__m128i*) last_tiles, _mm_cvttps_epi32(last));
+			#else
+			for (int32_t j = 0; j < 4; j += 1) {
+				float dy = fabsf(grid->light_y[i + j] - row_center) - tile_size * 0.5f;
+				if (dy < 0) dy = 0;
+				
+				float radius = grid->light_radius[i + j];
+				float reach_squared = radius * radius - dy * dy;
+				if (!(reach_squared > 0)) continue;
+				
+				float reach = sqrtf(reach_squared);
+				float first = (grid->light_x[i + j] - reach) * (1.0f / tile_size);
+				float last = (grid->light_x[i + j] + reach) * (1.0f / tile_size);
+				if (last < 0 || first > last_tile + 1) continue;
+				
+				first_tiles[j] = (int32_t) (first < 0 ? 0 : first > last_tile ? last_tile : first);
+				last_tiles[j] = (int32_t) (last < 0 ? 0 : last > last_tile ? last_tile : last);
+				mask |= 1 << j;
+			}
+			#endif
+			
+			for (int32_t j = 0; j < 4; j += 1) {
+				if (!(mask & (1 << j))) continue;
+				
+				for (int32_t tile = first_tiles[j]; tile <= last_tiles[j]; tile += 1) {
+					if (counts[tile] == max_lights_per_tile) {
+						dropped += 1;
+						continue;
+					}
+					lists[tile * max_lights_per_tile + counts[tile]] = i + j;
+					counts[tile] += 1;
+				}
+			}
+		}
+		
+		grid->row_dropped_counts[row] = dropped;
+	}
+	
+	void light_grid_update(LightGrid* grid, PointLight lights[], int32_t light_count) {
+		auto impl = (LightGridImpl*) grid;
+		paintbox_assert_log(light_count >= 0 && light_count <= grid->max_lights, "light_grid_update() got %d lights, but the grid was made for %d.", light_count, grid->max_lights);
+		
+		impl->padded_light_count = (light_count + 3) & ~3;
+		for (int32_t i = 0; i < light_count; i += 1) {
+			impl->light_x[i] = lights[i].position.x;
+			impl->light_y[i] = lights[i].position.y;
+			impl->light_radius[i] = lights[i].radius;
+		}
+		for (int32_t i = light_count; i < impl->padded_light_count; i += 1) {
+			impl->light_x[i] = 0;
+			impl->light_y[i] = 0;
+			impl->light_radius[i] = 0;
+		}
+		
+		parallel_for(grid->tiles_y, bin_tile_row, impl);
+		
+		// Pack the lists one after the other. Offsets count from the end of the header, like paintbox_light_tiles in the shader.
+		int32_t tile_count = grid->tiles_x * grid->tiles_y;
+		uint32_t* header = impl->tile_data;
+		uint32_t* tiles = header + light_grid_header_size;
+		
+		header[0] = light_tile_size;
+		header[1] = grid->tiles_x;
+		header[2] = grid->tiles_y;
+		header[3] = light_count;
+		
+		uint32_t offset = tile_count * 2;
+		for (int32_t i = 0; i < tile_count; i += 1) {
+			uint32_t count = impl->tile_counts[i];
+			tiles[i * 2 + 0] = offset;
+			tiles[i * 2 + 1] = count;
+			memcpy(tiles + offset, impl->tile_lights + i * max_lights_per_tile, count * sizeof(uint32_t));
+			offset += count;
+		}
+		
+		grid->dropped_count = 0;
+		for (int32_t row = 0; row < grid->tiles_y; row += 1) grid->dropped_count += impl->row_dropped_counts[row];
+		grid->light_count = light_count;
+		grid->index_count = offset - tile_count * 2;
+		
+		if (light_count > 0) buffer_upload(grid->light_buffer, 0, light_count * sizeof(PointLight), lights);
+		buffer_upload(grid->tile_buffer, 0, (light_grid_header_size + offset) * sizeof(uint32_t), impl->tile_data);
+	}
+	
+	void light_grid_bind(LightGrid* grid, RenderState* state) {
+		state->buffers[light_buffer_binding] = grid->light_buffer;
+		state->buffers[light_tile_buffer_binding] = grid->tile_buffer;
+	}
+	
+	void light_grid_destroy(LightGrid* grid) {
+		auto impl = (LightGridImpl*) grid;
+		
+		buffer_destroy(grid->light_buffer);
+		buffer_destroy(grid->tile_buffer);
+		
+		delete[] impl->light_x;
+		delete[] impl->light_y;
+		delete[] impl->light_radius;
+		delete[] impl->tile_counts;
+		delete[] impl->tile_lights;
+		delete[] impl->row_dropped_counts;
+		delete[] impl->tile_data;
+		delete impl;
+	}
+	
+	const char* light_grid_glsl() {
+		return glsl_light_grid_source;
+	}
+
+}
\ No newline at end of file
@@ -1,6 +1,101 @@
 #include "paintbox.h"
 
+#include <string.h> // For memcpy.
+
 namespace Paintbox {
+	//
+	// vec2
+	//
+	
+	vec2 operator-(vec2 v) { return {-v.x, -v.y}; }
+	
+	vec2 operator+(vec2 a, vec2 b) { return {a.x + b.x, a.y + b.y}; }
+	vec2 operator-(vec2 a, vec2 b) { return {a.x - b.x, a.y - b.y}; }
+	vec2 operator*(vec2 a, vec2 b) { return {a.x * b.x, a.y * b.y}; }
+	vec2 operator/(vec2 a, vec2 b) { return {a.x / b.x, a.y / b.y}; }
+	
+	vec2 operator*(vec2 v, float f) { return {v.x * f, v.y * f}; }
+	vec2 operator*(float f, vec2 v) { return {v.x * f, v.y * f}; }
+	
+	vec2 operator/(vec2 v, float f) { return {v.x / f, v.y / f}; }
+	
+	void operator+=(vec2& a, vec2 b) { a = a + b; }
+	void operator-=(vec2& a, vec2 b) { a = a - b; }
+	void operator*=(vec2& a, vec2 b) { a = a * b; }
+	void operator/=(vec2& a, vec2 b) { a = a / b; }
+	
+	void operator*=(vec2& v, float f) { v = v * f; }
+	void operator/=(vec2& v, float f) { v = v / f; }
+	
+	//
+	// vec3
+	//
+	
+	vec3 operator+(vec3 a, vec3 b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+	vec3 operator-(vec3 a, vec3 b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+	vec3 operator*(vec3 a, vec3 b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+	vec3 operator/(vec3 a, vec3 b) { return {a.x / b.x, a.y / b.y, a.z / b.z}; }
+	
+	vec3 operator*(vec3 v, float f) { return {v.x * f, v.y * f, v.z * f}; }
+	vec3 operator*(float f, vec3 v) { return {v.x * f, v.y * f, v.z * f}; }
+	
+	vec3 operator/(vec3 v, float f) { return {v.x / f, v.y / f, v.z / f}; }
+	
+	void operator+=(vec3& a, vec3 b) { a = a + b; }
+	void operator-=(vec3& a, vec3 b) { a = a - b; }
+	void operator*=(vec3& a, vec3 b) { a = a * b; }
+	void operator/=(vec3& a, vec3 b) { a = a / b; }
+	
+	void operator*=(vec3& v, float f) { v = v * f; }
+	void operator/=(vec3& v, float f) { v = v / f; }
+	
+	//
+	// vec4
+	//
+	
+	vec4 operator+(vec4 a, vec4 b) { return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w}; }
+	vec4 operator-(vec4 a, vec4 b) { return {a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w}; }
+	vec4 operator*(vec4 a, vec4 b) { return {a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w}; }
+	vec4 operator/(vec4 a, vec4 b) { return {a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w}; }
+	
+	vec4 operator*(vec4 v, float f) { return {v.x * f, v.y * f, v.z * f, v.w * f}; }
+	vec4 operator*(float f, vec4 v) { return {v.x * f, v.y * f, v.z * f, v.w * f}; }
+	
+	vec4 operator/(vec4 v, float f) { return {v.x / f, v.y / f, v.z / f, v.w / f}; }
+	
+	void operator+=(vec4& a, vec4 b) { a = a + b; }
+	void operator-=(vec4& a, vec4 b) { a = a - b; }
+	void operator*=(vec4& a, vec4 b) { a = a * b; }
+	void operator/=(vec4& a, vec4 b) { a = a / b; }
+	
+	void operator*=(vec4& v, float f) { v = v * f; }
+	void operator/=(vec4& v, float f) { v = v / f; }
+	
+	//
+	// mat4
+	//
+	
+	vec4 operator*(mat4 m, vec4 v) {
+		return {
+			m.m[0][0] * v.x + m.m[0][1] * v.y + m.m[0][2] * v.z + m.m[0][3] * v.w,
+			m.m[1][0] * v.x + m.m[1][1] * v.y + m.m[1][2] * v.z + m.m[1][3] * v.w,
+			m.m[2][0] * v.x + m.m[2][1] * v.y + m.m[2][2] * v.z + m.m[2][3] * v.w,
+			m.m[3][0] * v.x + m.m[3][1] * v.y + m.m[3][2] * v.z + m.m[3][3] * v.w,
+		};
+	}
+	
+	mat4 operator*(mat4 a, mat4 b) {
+		mat4 result = {};
+		for (int row = 0; row < 4; row += 1) {
+			for (int column = 0; column < 4; column += 1) {
+				float sum = 0;
+				for (int k = 0; k < 4; k += 1) sum += a.m[row][k] * b.m[k][column];
+				result.m[row][column] = sum;
+			}
+		}
+		return result;
+	}
+	
 	mat4 orthographic(float left, float right, float top, float bottom, float near, float far) {
 		float dx = right - left;
 		float dy = top - bottom;
@@ -22,4 +117,41 @@ namespace Paintbox {
 		};
 	}
 	
+	//
+	// Halves
+	//
+	
+	// ryg's float to half conversion, rounding to nearest even.
+	uint16_t float_to_half(float value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		
+		uint32_t sign = bits & 0x80000000u;
+		bits ^= sign;
+		
+		uint16_t result;
+		if (bits >= (143u << 23)) {
+			// Too big for a half: infinity, or a NaN if it was one.
+			result = bits > (255u << 23) ? 0x7E00 : 0x7C00;
+		} else if (bits < (113u << 23)) {
+			// Too small to be a normal half. Adding the magic number lets the FPU do the denormal rounding for us.
+			const uint32_t magic_bits = ((127 - 15) + (23 - 10) + 1) << 23;
+			float magic;
+			memcpy(&magic, &magic_bits, sizeof(magic));
+			
+			float sum;
+			memcpy(&sum, &bits, sizeof(sum));
+			sum += magic;
+			memcpy(&bits, &sum, sizeof(bits));
+			result = (uint16_t) (bits - magic_bits);
+		} else {
+			uint32_t mantissa_odd = (bits >> 13) & 1;
+			bits += ((uint32_t) (15 - 127) << 23) + 0xfff;
+			bits += mantissa_odd;
+			result = (uint16_t) (bits >> 13);
+		}
+		
+		return result | (uint16_t) (sign >> 16);
+	}
+
 }
\ No newline at end of file
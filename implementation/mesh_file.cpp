@@ -0,0 +1,146 @@
+#include "paintbox.h"
+
+#include <string.h> // For memcpy, memset
+
+namespace Paintbox {
+	
+	static bool mesh_file_range_is_valid(uint64_t offset, uint64_t size, uint64_t file_size) {
+		if (offset % mesh_file_alignment != 0) return false;
+		if (offset > file_size) return false;
+		return size <= file_size - offset;
+	}
+	
+	Mesh* mesh_load(const char* path) {
+		MappedFile file;
+		if (!file_map(path, &file)) {
+			paintbox_log("Failed to open mesh file '%s'.", path);
+			return nullptr;
+		}
+		
+		auto header = (MeshFileHeader*) file.data;
+		
+		const char* error = nullptr;
+		if (file.size < sizeof(MeshFileHeader))                                                         error = "the file is too small";
+		else if (header->magic != mesh_file_magic)                                                      error = "this is not a mesh file";
+		else if (header->version != mesh_file_version)                                                  error = "unsupported version";
+		else if (header->header_size != sizeof(MeshFileHeader))                                         error = "unexpected header size";
+		else if (header->vertex_format != (uint32_t) VertexFormat::XYZ_RGBA_UV)                         error = "unsupported vertex format";
+		else if (header->vertex_size != sizeof(Vertex))                                                 error = "unexpected vertex size";
+		else if (header->vertex_blob_size != (uint64_t) header->vertex_count * sizeof(Vertex))          error = "vertex blob size doesn't match the vertex count";
+		else if (header->index_blob_size != (uint64_t) header->index_count * sizeof(uint32_t))          error = "index blob size doesn't match the index count";
+		else if (header->vertex_blob_size > UINT32_MAX || header->index_blob_size > UINT32_MAX)         error = "the mesh is too big for a single buffer";
+		else if (!mesh_file_range_is_valid(header->vertex_offset, header->vertex_blob_size, file.size)) error = "vertex blob out of bounds";
+		else if (!mesh_file_range_is_valid(header->index_offset, header->index_blob_size, file.size))   error = "index blob out of bounds";
+		else if (header->lod_count > max_mesh_lods)                                                     error = "too many LODs";
+		
+		for (uint32_t i = 0; !error && i < header->lod_count; i += 1) {
+			MeshLod lod = header->lods[i];
+			if ((uint64_t) lod.first_index + lod.index_count > header->index_count) error = "LOD index range out of bounds";
+		}
+		
+		if (error) {
+			paintbox_log("Failed to load mesh file '%s': %s.", path, error);
+			file_unmap(&file);
+			return nullptr;
+		}
+		
+		// The blobs are already in the GPU layout, so the mapped pages go straight to the driver. We never parse or copy them ourselves.
+		// #speed: With buffer storage (GL 4.4) we could skip the driver-side copy too, by reading the file into a persistently mapped staging buffer.
+		auto vertices = (Vertex*) ((uint8_t*) file.data + header->vertex_offset);
+		auto indices = (uint32_t*) ((uint8_t*) file.data + header->index_offset);
+		
+		Mesh* mesh = mesh_create(header->vertex_count, header->index_count, vertices, indices);
+		mesh->bounds_min = header->bounds_min;
+		mesh->bounds_max = header->bounds_max;
+		mesh->lod_count = header->lod_count;
+		memcpy(mesh->lods, header->lods, sizeof(mesh->lods));
+		
+		// mesh_create is done with the memory by the time it returns.
+		file_unmap(&file);
+		return mesh;
+	}
+	
+	static bool write_padding(FILE* f, uint64_t* position, uint64_t alignment) {
+		static const uint8_t zeroes[mesh_file_alignment] = {};
+		
+		uint64_t padding = (alignment - *position % alignment) % alignment;
+		*position += padding;
+		return fwrite(zeroes, 1, (size_t) padding, f) == padding;
+	}
+	
+	bool mesh_save(const char* path, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[], MeshLod lods[], int32_t lod_count) {
+		paintbox_assert(lod_count >= 0 && lod_count <= max_mesh_lods);
+		
+		MeshFileHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = mesh_file_magic;
+		header.version = mesh_file_version;
+		header.header_size = sizeof(MeshFileHeader);
+		header.vertex_format = (uint32_t) VertexFormat::XYZ_RGBA_UV;
+		header.vertex_size = sizeof(Vertex);
+		header.vertex_count = vertex_count;
+		header.index_count = index_count;
+		
+		if (vertex_count > 0) {
+			header.bounds_min = vertices[0].position;
+			header.bounds_max = vertices[0].position;
+		}
+		for (uint32_t i = 1; i < vertex_count; i += 1) {
+			vec3 p = vertices[i].position;
+			if (p.x < header.bounds_min.x) header.bounds_min.x = p.x;
+			if (p.y < header.bounds_min.y) header.bounds_min.y = p.y;
+			if (p.z < header.bounds_min.z) header.bounds_min.z = p.z;
+			if (p.x > header.bounds_max.x) header.bounds_max.x = p.x;
+			if (p.y > header.bounds_max.y) header.bounds_max.y = p.y;
+			if (p.z > header.bounds_max.z) header.bounds_max.z = p.z;
+		}
+		
+		if (lod_count > 0) {
+			header.lod_count = lod_count;
+			for (int32_t i = 0; i < lod_count; i += 1) {
+				paintbox_assert((uint64_t) lods[i].first_index + lods[i].index_count <= index_count);
+				header.lods[i] = lods[i];
+			}
+		} else {
+			header.lod_count = 1;
+			header.lods[0].index_count = index_count;
+		}
+		
+		header.vertex_blob_size = (uint64_t) vertex_count * sizeof(Vertex);
+		header.index_blob_size = (uint64_t) index_count * sizeof(uint32_t);
+		
+		auto align = [](uint64_t value) { return (value + mesh_file_alignment - 1) / mesh_file_alignment * mesh_file_alignment; };
+		header.vertex_offset = align(sizeof(MeshFileHeader));
+		header.index_offset = align(header.vertex_offset + header.vertex_blob_size);
+		
+		FILE* f = fopen(path, "wb");
+		if (!f) {
+			paintbox_log("Failed to open '%s' for writing.", path);
+			return false;
+		}
+		
+		uint64_t position = 0;
+		bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+		position += sizeof(header);
+		
+		ok = ok && write_padding(f, &position, mesh_file_alignment);
+		ok = ok && fwrite(vertices, 1, (size_t) header.vertex_blob_size, f) == header.vertex_blob_size;
+		position += header.vertex_blob_size;
+		
+		ok = ok && write_padding(f, &position, mesh_file_alignment);
+		ok = ok && fwrite(indices, 1, (size_t) header.index_blob_size, f) == header.index_blob_size;
+		
+		ok = (fclose(f) == 0) && ok;
+		if (!ok) paintbox_log("Failed to write mesh file '%s'.", path);
+		return ok;
+	}
+	
+	int32_t mesh_select_lod(Mesh* mesh, float distance) {
+		int32_t result = 0;
+		for (int32_t i = 1; i < mesh->lod_count; i += 1) {
+			if (distance >= mesh->lods[i].distance) result = i;
+		}
+		return result;
+	}
+
+}
\ No newline at end of file
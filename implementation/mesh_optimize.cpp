@@ -0,0 +1,418 @@
+#include "paintbox.h"
+
+#include <math.h>
+#include <string.h> // For memcpy, memcmp, memset.
+
+namespace Paintbox {
+	
+	//
+	// Welding
+	//
+	
+	static uint32_t vertex_hash(Vertex* vertex) {
+		// FNV-1a over the raw bytes. Vertices only weld when they are identical bit for bit, so there's no epsilon to get wrong.
+		auto bytes = (uint8_t*) vertex;
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); i += 1) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+	
+	// Moves the unique vertices to the front of the array, and rewrites the indices to point at them. Returns how many unique vertices there are.
+	static uint32_t mesh_weld(Vertex vertices[], uint32_t vertex_count, uint32_t indices[], uint32_t index_count) {
+		uint32_t table_size = 1;
+		while (table_size < vertex_count * 2) table_size *= 2;
+		
+		// Open addressing, with the index of the unique vertex in each slot.
+		uint32_t* table = (uint32_t*) malloc(table_size * sizeof(uint32_t));
+		uint32_t* remap = (uint32_t*) malloc(vertex_count * sizeof(uint32_t));
+		paintbox_assert(table && remap);
+		memset(table, 0xff, table_size * sizeof(uint32_t));
+		
+		uint32_t unique_count = 0;
+		for (uint32_t i = 0; i < vertex_count; i += 1) {
+			uint32_t slot = vertex_hash(&vertices[i]) & (table_size - 1);
+			
+			while (true) {
+				uint32_t existing = table[slot];
+				
+				if (existing == UINT32_MAX) {
+					// unique_count <= i, so this never overwrites a vertex we haven't looked at yet.
+					vertices[unique_count] = vertices[i];
+					table[slot] = unique_count;
+					remap[i] = unique_count;
+					unique_count += 1;
+					break;
+				}
+				
+				if (memcmp(&vertices[existing], &vertices[i], sizeof(Vertex)) == 0) {
+					remap[i] = existing;
+					break;
+				}
+				
+				slot = (slot + 1) & (table_size - 1);
+			}
+		}
+		
+		for (uint32_t i = 0; i < index_count; i += 1) indices[i] = remap[indices[i]];
+		
+		free(table);
+		free(remap);
+		return unique_count;
+	}
+	
+	//
+	// Vertex cache
+	//
+	
+	// Tom Forsyth's "Linear-speed vertex cache optimisation". Triangles are emitted greedily: the next one is the best scoring triangle that uses a vertex in a simulated LRU cache.
+	// A vertex scores higher the more recently it was used, and the fewer triangles it has left, so that no vertex gets stranded with a single triangle that has to load it again later.
+	constexpr int32_t vertex_cache_size = 32;
+	constexpr uint32_t max_valence_score = 32;
+	
+	static float cache_position_scores[vertex_cache_size];
+	static float valence_scores[max_valence_score];
+	static bool vertex_scores_initialized = false; // #thread_safety
+	
+	static void vertex_scores_initialize() {
+		if (vertex_scores_initialized) return;
+		
+		for (int32_t i = 0; i < vertex_cache_size; i += 1) {
+			// The three vertices of the triangle that was just emitted get a fixed score, or they'd win every time and we'd end up with long thin strips.
+			if (i < 3) cache_position_scores[i] = 0.75f;
+			else cache_position_scores[i] = powf(1 - (float) (i - 3) / (vertex_cache_size - 3), 1.5f);
+		}
+		
+		for (uint32_t i = 0; i < max_valence_score; i += 1) {
+			valence_scores[i] = i == 0 ? 0 : 2 * powf((float) i, -0.5f);
+		}
+		
+		vertex_scores_initialized = true;
+	}
+	
+	static float vertex_score(int32_t cache_position, uint32_t triangles_left) {
+		if (triangles_left == 0) return -1; // Nothing left to draw with it.
+		
+		float score = cache_position >= 0 ? cache_position_scores[cache_position] : 0;
+		score += triangles_left < max_valence_score ? valence_scores[triangles_left] : 2 * powf((float) triangles_left, -0.5f);
+		return score;
+	}
+	
+	static void mesh_order_triangles_for_cache(uint32_t indices[], uint32_t index_count, uint32_t vertex_count) {
+		vertex_scores_initialize();
+		
+		uint32_t triangle_count = index_count / 3;
+		
+		// The triangles of every vertex, packed in one array. Emitted triangles are swapped past the end of their vertices' ranges.
+		uint32_t* triangle_offsets = (uint32_t*) calloc(vertex_count + 1, sizeof(uint32_t));
+		uint32_t* triangles_left = (uint32_t*) calloc(vertex_count, sizeof(uint32_t));
+		uint32_t* vertex_triangles = (uint32_t*) malloc(index_count * sizeof(uint32_t));
+		int32_t* cache_positions = (int32_t*) malloc(vertex_count * sizeof(int32_t));
+		float* vertex_scores = (float*) malloc(vertex_count * sizeof(float));
+		float* triangle_scores = (float*) malloc(triangle_count * sizeof(float));
+		bool* triangle_emitted = (bool*) calloc(triangle_count, sizeof(bool));
+		uint32_t* output = (uint32_t*) malloc(index_count * sizeof(uint32_t));
+		paintbox_assert(triangle_offsets && triangles_left && vertex_triangles && cache_positions && vertex_scores && triangle_scores && triangle_emitted && output);
+		
+		for (uint32_t i = 0; i < index_count; i += 1) triangle_offsets[indices[i] + 1] += 1;
+		for (uint32_t v = 0; v < vertex_count; v += 1) triangle_offsets[v + 1] += triangle_offsets[v];
+		
+		for (uint32_t i = 0; i < index_count; i += 1) {
+			uint32_t v = indices[i];
+			vertex_triangles[triangle_offsets[v] + triangles_left[v]] = i / 3;
+			triangles_left[v] += 1;
+		}
+		
+		for (uint32_t v = 0; v < vertex_count; v += 1) {
+			cache_positions[v] = -1;
+			vertex_scores[v] = vertex_score(-1, triangles_left[v]);
+		}
+		
+		for (uint32_t t = 0; t < triangle_count; t += 1) {
+			uint32_t* triangle = &indices[t * 3];
+			triangle_scores[t] = vertex_scores[triangle[0]] + vertex_scores[triangle[1]] + vertex_scores[triangle[2]];
+		}
+		
+		// Room for the three new vertices on top of a full cache. Whatever ends up past vertex_cache_size falls out.
+		uint32_t cache[vertex_cache_size + 3];
+		int32_t cache_count = 0;
+		
+		uint32_t best_triangle = 0;
+		uint32_t next_unemitted = 0; // Where to look when the cache has nothing to offer, like at the start of a new disconnected piece.
+		
+		for (uint32_t emitted = 0; emitted < triangle_count; emitted += 1) {
+			if (best_triangle == UINT32_MAX) {
+				while (triangle_emitted[next_unemitted]) next_unemitted += 1;
+				best_triangle = next_unemitted;
+			}
+			
+			uint32_t* triangle = &indices[best_triangle * 3];
+			memcpy(&output[emitted * 3], triangle, 3 * sizeof(uint32_t));
+			triangle_emitted[best_triangle] = true;
+			
+			uint32_t new_cache[vertex_cache_size + 3];
+			int32_t new_cache_count = 0;
+			
+			for (int k = 0; k < 3; k += 1) {
+				uint32_t v = triangle[k];
+				
+				// Take the triangle out of the vertex's list of triangles left.
+				uint32_t* list = &vertex_triangles[triangle_offsets[v]];
+				for (uint32_t i = 0; i < triangles_left[v]; i += 1) {
+					if (list[i] == best_triangle) {
+						list[i] = list[triangles_left[v] - 1];
+						list[triangles_left[v] - 1] = best_triangle;
+						break;
+					}
+				}
+				triangles_left[v] -= 1;
+				
+				new_cache[new_cache_count] = v;
+				new_cache_count += 1;
+			}
+			
+			for (int32_t i = 0; i < cache_count; i += 1) {
+				uint32_t v = cache[i];
+				if (v == triangle[0] || v == triangle[1] || v == triangle[2]) continue;
+				new_cache[new_cache_count] = v;
+				new_cache_count += 1;
+			}
+			
+			// Rescore every vertex whose cache position or triangle count changed, including the ones that just fell out, and pass the difference on to their triangles.
+			for (int32_t i = 0; i < new_cache_count; i += 1) {
+				uint32_t v = new_cache[i];
+				cache_positions[v] = i < vertex_cache_size ? i : -1;
+				
+				float score = vertex_score(cache_positions[v], triangles_left[v]);
+				float difference = score - vertex_scores[v];
+				vertex_scores[v] = score;
+				
+				uint32_t* list = &vertex_triangles[triangle_offsets[v]];
+				for (uint32_t j = 0; j < triangles_left[v]; j += 1) triangle_scores[list[j]] += difference;
+			}
+			
+			cache_count = new_cache_count < vertex_cache_size ? new_cache_count : vertex_cache_size;
+			memcpy(cache, new_cache, cache_count * sizeof(uint32_t));
+			
+			// Only triangles that touch the cache changed score, so that's the only place the next best one can be.
+			best_triangle = UINT32_MAX;
+			float best_score = -1;
+			for (int32_t i = 0; i < cache_count; i += 1) {
+				uint32_t v = cache[i];
+				uint32_t* list = &vertex_triangles[triangle_offsets[v]];
+				for (uint32_t j = 0; j < triangles_left[v]; j += 1) {
+					if (triangle_scores[list[j]] > best_score) {
+						best_triangle = list[j];
+						best_score = triangle_scores[list[j]];
+					}
+				}
+			}
+		}
+		
+		memcpy(indices, output, index_count * sizeof(uint32_t));
+		
+		free(triangle_offsets);
+		free(triangles_left);
+		free(vertex_triangles);
+		free(cache_positions);
+		free(vertex_scores);
+		free(triangle_scores);
+		free(triangle_emitted);
+		free(output);
+	}
+	
+	//
+	// Overdraw
+	//
+	
+	// The cache order is cut into small clusters, which are sorted so the ones facing outwards and far from the center come first.
+	// Those are the most likely to cover the rest of the mesh, whatever the view, so more of the later triangles fail the depth test before shading.
+	// Cutting the order into clusters costs a few cache misses at every cut, which is why they aren't smaller.
+	constexpr uint32_t overdraw_cluster_triangles = 64;
+	
+	struct TriangleCluster {
+		uint32_t first_triangle;
+		uint32_t triangle_count;
+		float sort_key;
+	};
+	
+	static int compare_triangle_clusters(const void* a_pointer, const void* b_pointer) {
+		auto a = (const TriangleCluster*) a_pointer;
+		auto b = (const TriangleCluster*) b_pointer;
+		
+		if (a->sort_key != b->sort_key) return a->sort_key > b->sort_key ? -1 : 1;
+		return a->first_triangle < b->first_triangle ? -1 : 1;
+	}
+	
+	// Twice the area of the triangle, in the direction it faces (counter-clockwise is the front, like GL's default).
+	static vec3 triangle_area_normal(Vertex vertices[], uint32_t* triangle) {
+		vec3 a = vertices[triangle[0]].position;
+		vec3 b = vertices[triangle[1]].position;
+		vec3 c = vertices[triangle[2]].position;
+		
+		vec3 ab = vec3(b.x - a.x, b.y - a.y, b.z - a.z);
+		vec3 ac = vec3(c.x - a.x, c.y - a.y, c.z - a.z);
+		return vec3(ab.y * ac.z - ab.z * ac.y, ab.z * ac.x - ab.x * ac.z, ab.x * ac.y - ab.y * ac.x);
+	}
+	
+	static void mesh_order_clusters_for_overdraw(Vertex vertices[], uint32_t indices[], uint32_t index_count) {
+		uint32_t triangle_count = index_count / 3;
+		uint32_t cluster_count = (triangle_count + overdraw_cluster_triangles - 1) / overdraw_cluster_triangles;
+		if (cluster_count < 2) return;
+		
+		TriangleCluster* clusters = (TriangleCluster*) malloc(cluster_count * sizeof(TriangleCluster));
+		vec3* cluster_centers = (vec3*) malloc(cluster_count * sizeof(vec3));
+		vec3* cluster_normals = (vec3*) malloc(cluster_count * sizeof(vec3));
+		uint32_t* output = (uint32_t*) malloc(index_count * sizeof(uint32_t));
+		paintbox_assert(clusters && cluster_centers && cluster_normals && output);
+		
+		// Area weighted, so a pile of tiny triangles doesn't drag the centers around.
+		vec3 mesh_center = {};
+		float mesh_area = 0;
+		
+		for (uint32_t c = 0; c < cluster_count; c += 1) {
+			TriangleCluster* cluster = &clusters[c];
+			cluster->first_triangle = c * overdraw_cluster_triangles;
+			cluster->triangle_count = triangle_count - cluster->first_triangle < overdraw_cluster_triangles ? triangle_count - cluster->first_triangle : overdraw_cluster_triangles;
+			
+			vec3 center = {};
+			vec3 normal = {};
+			float area = 0;
+			
+			for (uint32_t t = cluster->first_triangle; t < cluster->first_triangle + cluster->triangle_count; t += 1) {
+				uint32_t* triangle = &indices[t * 3];
+				vec3 area_normal = triangle_area_normal(vertices, triangle);
+				float triangle_area = sqrtf(area_normal.x * area_normal.x + area_normal.y * area_normal.y + area_normal.z * area_normal.z);
+				
+				vec3 a = vertices[triangle[0]].position;
+				vec3 b = vertices[triangle[1]].position;
+				vec3 c = vertices[triangle[2]].position;
+				center.x += (a.x + b.x + c.x) * triangle_area;
+				center.y += (a.y + b.y + c.y) * triangle_area;
+				center.z += (a.z + b.z + c.z) * triangle_area;
+				
+				normal.x += area_normal.x;
+				normal.y += area_normal.y;
+				normal.z += area_normal.z;
+				area += triangle_area;
+			}
+			
+			mesh_center.x += center.x;
+			mesh_center.y += center.y;
+			mesh_center.z += center.z;
+			mesh_area += area;
+			
+			float scale = area > 0 ? 1 / (3 * area) : 0;
+			cluster_centers[c] = vec3(center.x * scale, center.y * scale, center.z * scale);
+			cluster_normals[c] = normal;
+		}
+		
+		float mesh_scale = mesh_area > 0 ? 1 / (3 * mesh_area) : 0;
+		mesh_center = vec3(mesh_center.x * mesh_scale, mesh_center.y * mesh_scale, mesh_center.z * mesh_scale);
+		
+		for (uint32_t c = 0; c < cluster_count; c += 1) {
+			vec3 normal = cluster_normals[c];
+			float length = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+			
+			// Clusters that face every way at once can't be said to be in front of anything, so they go in the middle.
+			if (length == 0) {
+				clusters[c].sort_key = 0;
+				continue;
+			}
+			
+			vec3 offset = vec3(cluster_centers[c].x - mesh_center.x, cluster_centers[c].y - mesh_center.y, cluster_centers[c].z - mesh_center.z);
+			clusters[c].sort_key = (offset.x * normal.x + offset.y * normal.y + offset.z * normal.z) / length;
+		}
+		
+		qsort(clusters, cluster_count, sizeof(TriangleCluster), compare_triangle_clusters);
+		
+		uint32_t written = 0;
+		for (uint32_t c = 0; c < cluster_count; c += 1) {
+			uint32_t size = clusters[c].triangle_count * 3;
+			memcpy(&output[written], &indices[clusters[c].first_triangle * 3], size * sizeof(uint32_t));
+			written += size;
+		}
+		memcpy(indices, output, index_count * sizeof(uint32_t));
+		
+		free(clusters);
+		free(cluster_centers);
+		free(cluster_normals);
+		free(output);
+	}
+	
+	//
+	// Vertex fetch
+	//
+	
+	// Puts the vertices in the order the indices first use them, so fetching them walks through memory mostly forwards. Vertices no triangle uses are dropped.
+	static uint32_t mesh_order_vertices_for_fetch(Vertex vertices[], uint32_t vertex_count, uint32_t indices[], uint32_t index_count) {
+		uint32_t* remap = (uint32_t*) malloc(vertex_count * sizeof(uint32_t));
+		paintbox_assert(remap);
+		memset(remap, 0xff, vertex_count * sizeof(uint32_t));
+		
+		uint32_t used_count = 0;
+		for (uint32_t i = 0; i < index_count; i += 1) {
+			uint32_t v = indices[i];
+			if (remap[v] == UINT32_MAX) {
+				remap[v] = used_count;
+				used_count += 1;
+			}
+			indices[i] = remap[v];
+		}
+		
+		Vertex* reordered = (Vertex*) malloc(used_count * sizeof(Vertex));
+		paintbox_assert(reordered || used_count == 0);
+		for (uint32_t v = 0; v < vertex_count; v += 1) {
+			if (remap[v] != UINT32_MAX) reordered[remap[v]] = vertices[v];
+		}
+		memcpy(vertices, reordered, used_count * sizeof(Vertex));
+		
+		free(reordered);
+		free(remap);
+		return used_count;
+	}
+	
+	uint32_t mesh_optimize(Vertex vertices[], uint32_t vertex_count, uint32_t indices[], uint32_t index_count) {
+		paintbox_assert_log(index_count % 3 == 0, "mesh_optimize() takes triangles, but got %u indices.", index_count);
+		for (uint32_t i = 0; i < index_count; i += 1) {
+			paintbox_assert_log(indices[i] < vertex_count, "Index %u is %u, but there are only %u vertices.", i, indices[i], vertex_count);
+		}
+		if (index_count == 0) return 0; // No triangles use any of the vertices.
+		
+		vertex_count = mesh_weld(vertices, vertex_count, indices, index_count);
+		mesh_order_triangles_for_cache(indices, index_count, vertex_count);
+		mesh_order_clusters_for_overdraw(vertices, indices, index_count);
+		return mesh_order_vertices_for_fetch(vertices, vertex_count, indices, index_count);
+	}
+	
+	Mesh* mesh_create_optimized(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint32_t indices[]) {
+		// The caller's arrays are left alone.
+		Vertex* optimized_vertices = (Vertex*) malloc(vertex_count * sizeof(Vertex));
+		uint32_t* optimized_indices = (uint32_t*) malloc(index_count * sizeof(uint32_t));
+		paintbox_assert(optimized_vertices && optimized_indices);
+		memcpy(optimized_vertices, vertices, vertex_count * sizeof(Vertex));
+		memcpy(optimized_indices, indices, index_count * sizeof(uint32_t));
+		
+		uint32_t optimized_vertex_count = mesh_optimize(optimized_vertices, vertex_count, optimized_indices, index_count);
+		
+		Mesh* mesh;
+		if (optimized_vertex_count <= 65536) {
+			// Half the index memory and index fetch bandwidth. We never turn primitive restart on, so 0xFFFF is an index like any other.
+			uint16_t* short_indices = (uint16_t*) malloc(index_count * sizeof(uint16_t));
+			paintbox_assert(short_indices);
+			for (uint32_t i = 0; i < index_count; i += 1) short_indices[i] = (uint16_t) optimized_indices[i];
+			
+			mesh = mesh_create_u16(optimized_vertex_count, index_count, optimized_vertices, short_indices);
+			free(short_indices);
+		} else {
+			mesh = mesh_create(optimized_vertex_count, index_count, optimized_vertices, optimized_indices);
+		}
+		
+		free(optimized_vertices);
+		free(optimized_indices);
+		return mesh;
+	}
+
+}
\ No newline at end of file
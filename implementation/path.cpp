@@ -0,0 +1,876 @@
+#include "paintbox.h"
+
+#include <math.h>
+#include <string.h> // For memcpy, memset.
+
+namespace Paintbox {
+	
+	//
+	// Small helpers
+	//
+	
+	// #temporary: A tiny growable array for the tessellator scratch memory. If other modules need this, it should move somewhere shared.
+	template <typename T>
+	struct Array {
+		T* data = nullptr;
+		int32_t count = 0;
+		int32_t capacity = 0;
+		
+		void reserve(int32_t needed) {
+			if (needed <= capacity) return;
+			int32_t new_capacity = capacity ? capacity * 2 : 64;
+			while (new_capacity < needed) new_capacity *= 2;
+			data = (T*) realloc(data, new_capacity * sizeof(T));
+			paintbox_assert(data);
+			capacity = new_capacity;
+		}
+		
+		T* add(T value) {
+			reserve(count + 1);
+			data[count] = value;
+			return &data[count++];
+		}
+		
+		T& operator[](int32_t index) { return data[index]; }
+	};
+	
+	static float dot(vec2 a, vec2 b)   { return a.x * b.x + a.y * b.y; }
+	static float cross(vec2 a, vec2 b) { return a.x * b.y - a.y * b.x; }
+	static float length(vec2 v)        { return sqrtf(dot(v, v)); }
+	static vec2  perpendicular(vec2 v) { return {-v.y, v.x}; } // Rotates 90 degrees counter-clockwise.
+	
+	static vec2 normalize(vec2 v) {
+		float l = length(v);
+		if (l < 1e-12f) return {0, 0};
+		return v / l;
+	}
+	
+	template <typename T>
+	static T clamp(T value, T low, T high) { return value < low ? low : (value > high ? high : value); }
+	
+	//
+	// Path building
+	//
+	
+	static void path_add_verb(Path* path, PathVerb verb, int32_t point_count) {
+		if (path->verb_count + 1 > path->verb_capacity) {
+			path->verb_capacity = path->verb_capacity ? path->verb_capacity * 2 : 32;
+			path->verbs = (PathVerb*) realloc(path->verbs, path->verb_capacity * sizeof(PathVerb));
+			paintbox_assert(path->verbs);
+		}
+		
+		if (path->point_count + point_count > path->point_capacity) {
+			int32_t capacity = path->point_capacity ? path->point_capacity * 2 : 64;
+			while (capacity < path->point_count + point_count) capacity *= 2;
+			path->points = (vec2*) realloc(path->points, capacity * sizeof(vec2));
+			paintbox_assert(path->points);
+			path->point_capacity = capacity;
+		}
+		
+		path->verbs[path->verb_count++] = verb;
+	}
+	
+	void path_clear(Path* path) {
+		path->verb_count = 0;
+		path->point_count = 0;
+		path->contour_start = 0;
+	}
+	
+	void path_free(Path* path) {
+		free(path->verbs);
+		free(path->points);
+		*path = {};
+	}
+	
+	void path_move_to(Path* path, vec2 point) {
+		path_add_verb(path, PathVerb::MOVE, 1);
+		path->contour_start = path->point_count;
+		path->points[path->point_count++] = point;
+	}
+	
+	// Makes sure a segment ending at 'point' has a current point to start from. Returns false when there was none, and 'point' started the contour instead.
+	// After a close the segment would otherwise be added to the closed contour, so a new one starts where that one did, like SVG does.
+	static bool path_begin_segment(Path* path, vec2 point) {
+		if (path->verb_count == 0) {
+			path_move_to(path, point);
+			return false;
+		}
+		
+		if (path->verbs[path->verb_count - 1] == PathVerb::CLOSE) path_move_to(path, path->points[path->contour_start]);
+		return true;
+	}
+	
+	void path_line_to(Path* path, vec2 point) {
+		if (!path_begin_segment(path, point)) return;
+		
+		path_add_verb(path, PathVerb::LINE, 1);
+		path->points[path->point_count++] = point;
+	}
+	
+	void path_quad_to(Path* path, vec2 control, vec2 point) {
+		if (!path_begin_segment(path, point)) return;
+		
+		path_add_verb(path, PathVerb::QUAD, 2);
+		path->points[path->point_count++] = control;
+		path->points[path->point_count++] = point;
+	}
+	
+	void path_cubic_to(Path* path, vec2 control0, vec2 control1, vec2 point) {
+		if (!path_begin_segment(path, point)) return;
+		
+		path_add_verb(path, PathVerb::CUBIC, 3);
+		path->points[path->point_count++] = control0;
+		path->points[path->point_count++] = control1;
+		path->points[path->point_count++] = point;
+	}
+	
+	void path_arc(Path* path, vec2 center, float radius, float start_angle, float end_angle) {
+		vec2 start = center + vec2(cosf(start_angle), sinf(start_angle)) * radius;
+		
+		bool has_current_point = path->verb_count > 0 && path->verbs[path->verb_count - 1] != PathVerb::CLOSE;
+		if (has_current_point) path_line_to(path, start);
+		else                   path_move_to(path, start);
+		
+		// Each piece of the arc spans at most a quarter turn, which keeps the cubic approximation error below 0.03% of the radius.
+		float sweep = end_angle - start_angle;
+		int pieces = (int) ceilf(fabsf(sweep) / (0.5f * 3.14159265f));
+		if (pieces < 1) pieces = 1;
+		
+		float step = sweep / pieces;
+		float k = 4.0f / 3.0f * tanf(step / 4); // Distance of the control points to the end points, relative to the radius.
+		
+		float angle = start_angle;
+		for (int i = 0; i < pieces; i += 1) {
+			float next_angle = angle + step;
+			
+			vec2 d0 = {cosf(angle), sinf(angle)};
+			vec2 d1 = {cosf(next_angle), sinf(next_angle)};
+			
+			vec2 p0 = center + d0 * radius;
+			vec2 p3 = center + d1 * radius;
+			vec2 p1 = p0 + perpendicular(d0) * (radius * k);
+			vec2 p2 = p3 - perpendicular(d1) * (radius * k);
+			
+			path_cubic_to(path, p1, p2, p3);
+			angle = next_angle;
+		}
+	}
+	
+	void path_close(Path* path) {
+		if (path->verb_count == 0) return;
+		path_add_verb(path, PathVerb::CLOSE, 0);
+	}
+	
+	void path_rect(Path* path, Rect rect) {
+		path_move_to(path, {rect.x, rect.y});
+		path_line_to(path, {rect.x + rect.w, rect.y});
+		path_line_to(path, {rect.x + rect.w, rect.y + rect.h});
+		path_line_to(path, {rect.x, rect.y + rect.h});
+		path_close(path);
+	}
+	
+	void path_circle(Path* path, vec2 center, float radius) {
+		// Start a new contour so the arc does not get connected to whatever came before.
+		path_move_to(path, center + vec2(radius, 0));
+		path_arc(path, center, radius, 0, 2 * 3.14159265f);
+		path_close(path);
+	}
+	
+	//
+	// Flattening
+	//
+	
+	struct Contour {
+		int32_t first_point = 0;
+		int32_t point_count = 0;
+		bool closed = false;
+	};
+	
+	// #thread_safety: The tessellator keeps its scratch memory in globals, so it can only be used from one thread at a time.
+	static Array<vec2> flat_points;
+	static Array<Contour> contours;
+	
+	static void flat_add(vec2 point) {
+		Contour* contour = &contours[contours.count - 1];
+		
+		// Skip points that would produce zero length segments.
+		if (contour->point_count > 0) {
+			vec2 last = flat_points[flat_points.count - 1];
+			vec2 delta = point - last;
+			if (dot(delta, delta) < 1e-12f) return;
+		}
+		
+		flat_points.add(point);
+		contour->point_count += 1;
+	}
+	
+	static void flatten_path(Path* path, float tolerance) {
+		flat_points.count = 0;
+		contours.count = 0;
+		
+		vec2 current = {0, 0};
+		int32_t p = 0;
+		
+		for (int32_t i = 0; i < path->verb_count; i += 1) {
+			switch (path->verbs[i]) {
+			  case PathVerb::MOVE: {
+					Contour contour;
+					contour.first_point = flat_points.count;
+					contours.add(contour);
+					
+					current = path->points[p++];
+					flat_add(current);
+				} break;
+			
+			  case PathVerb::LINE: {
+					current = path->points[p++];
+					flat_add(current);
+				} break;
+			
+			  case PathVerb::QUAD: {
+					vec2 p0 = current;
+					vec2 p1 = path->points[p++];
+					vec2 p2 = path->points[p++];
+					
+					// Wang's formula: the number of uniform segments that keeps the flattening error below the tolerance.
+					float m = length(p0 - p1 * 2 + p2);
+					int n = (int) ceilf(sqrtf(0.25f * m / tolerance));
+					n = clamp(n, 1, 256);
+					
+					for (int k = 1; k <= n; k += 1) {
+						float t = (float) k / n;
+						float s = 1 - t;
+						flat_add(p0 * (s * s) + p1 * (2 * s * t) + p2 * (t * t));
+					}
+					current = p2;
+				} break;
+			
+			  case PathVerb::CUBIC: {
+					vec2 p0 = current;
+					vec2 p1 = path->points[p++];
+					vec2 p2 = path->points[p++];
+					vec2 p3 = path->points[p++];
+					
+					float m0 = length(p0 - p1 * 2 + p2);
+					float m1 = length(p1 - p2 * 2 + p3);
+					float m = m0 > m1 ? m0 : m1;
+					int n = (int) ceilf(sqrtf(0.75f * m / tolerance));
+					n = clamp(n, 1, 256);
+					
+					for (int k = 1; k <= n; k += 1) {
+						float t = (float) k / n;
+						float s = 1 - t;
+						flat_add(p0 * (s * s * s) + p1 * (3 * s * s * t) + p2 * (3 * s * t * t) + p3 * (t * t * t));
+					}
+					current = p3;
+				} break;
+			
+			  case PathVerb::CLOSE: {
+					Contour* contour = &contours[contours.count - 1];
+					contour->closed = true;
+					
+					// Drop the last point if it landed on the first one, closed contours connect them anyway.
+					if (contour->point_count > 1) {
+						vec2 first = flat_points[contour->first_point];
+						vec2 delta = flat_points[flat_points.count - 1] - first;
+						if (dot(delta, delta) < 1e-12f) {
+							flat_points.count -= 1;
+							contour->point_count -= 1;
+						}
+					}
+					
+					current = flat_points[contour->first_point];
+				} break;
+			
+			  default: paintbox_assert(false);
+			}
+		}
+	}
+	
+	//
+	// Output
+	//
+	
+	static Array<Vertex> out_vertices;
+	static Array<uint32_t> out_indices;
+	
+	static vec4 out_color;
+	static float out_z;
+	
+	static uint32_t emit_vertex(vec2 position, float alpha) {
+		Vertex v;
+		v.position = {position, out_z};
+		v.color = out_color;
+		v.color.w *= alpha;
+		v.uv = position; // Handy for gradients and textured shapes.
+		out_vertices.add(v);
+		return out_vertices.count - 1;
+	}
+	
+	static void emit_triangle(uint32_t a, uint32_t b, uint32_t c) {
+		out_indices.reserve(out_indices.count + 3);
+		out_indices.data[out_indices.count++] = a;
+		out_indices.data[out_indices.count++] = b;
+		out_indices.data[out_indices.count++] = c;
+	}
+	
+	static void emit_quad(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+		emit_triangle(a, b, c);
+		emit_triangle(a, c, d);
+	}
+	
+	//
+	// Fill
+	//
+	// We split the plane into horizontal bands at every vertex and every edge intersection.
+	// Inside a band no edges start, end or cross, so the edges can be sorted by x and walked from left to right while accumulating the winding number.
+	// Each span that is inside according to the fill rule becomes a trapezoid.
+	// This handles holes, self intersections and both fill rules, which plain ear clipping would not.
+	//
+	
+	struct Edge {
+		float x0, y0; // Top end (smaller y).
+		float x1, y1;
+		float dxdy;
+		int32_t winding;
+		
+		float x_at(float y) { return x0 + (y - y0) * dxdy; }
+	};
+	
+	struct ActiveEdge {
+		Edge* edge;
+		float x_top;
+		float x_bottom;
+	};
+	
+	static Array<Edge> edges;
+	static Array<float> band_ys;
+	static Array<ActiveEdge> active;
+	
+	static void sort_floats(float* values, int32_t count) {
+		// Insertion sort for small inputs, otherwise qsort.
+		if (count < 32) {
+			for (int32_t i = 1; i < count; i += 1) {
+				float v = values[i];
+				int32_t j = i - 1;
+				while (j >= 0 && values[j] > v) { values[j + 1] = values[j]; j -= 1; }
+				values[j + 1] = v;
+			}
+			return;
+		}
+		
+		qsort(values, count, sizeof(float), [](const void* a, const void* b) -> int {
+			float fa = *(const float*) a, fb = *(const float*) b;
+			return (fa > fb) - (fa < fb);
+		});
+	}
+	
+	static void sort_edges_by_top(Edge* values, int32_t count) {
+		qsort(values, count, sizeof(Edge), [](const void* a, const void* b) -> int {
+			float fa = ((const Edge*) a)->y0, fb = ((const Edge*) b)->y0;
+			return (fa > fb) - (fa < fb);
+		});
+	}
+	
+	static void sort_active(ActiveEdge* values, int32_t count) {
+		// The active list is mostly sorted from the previous band already, so insertion sort is the right tool here.
+		for (int32_t i = 1; i < count; i += 1) {
+			ActiveEdge v = values[i];
+			int32_t j = i - 1;
+			while (j >= 0 && (values[j].x_top > v.x_top || (values[j].x_top == v.x_top && values[j].x_bottom > v.x_bottom))) {
+				values[j + 1] = values[j];
+				j -= 1;
+			}
+			values[j + 1] = v;
+		}
+	}
+	
+	static bool inside(int32_t winding, FillRule rule) {
+		if (rule == FillRule::EVEN_ODD) return (winding & 1) != 0;
+		return winding != 0;
+	}
+	
+	static void fill_interior(FillRule rule) {
+		edges.count = 0;
+		band_ys.count = 0;
+		
+		for (int32_t c = 0; c < contours.count; c += 1) {
+			Contour contour = contours[c];
+			if (contour.point_count < 3) continue;
+			
+			for (int32_t i = 0; i < contour.point_count; i += 1) {
+				vec2 a = flat_points[contour.first_point + i];
+				vec2 b = flat_points[contour.first_point + (i + 1) % contour.point_count];
+				band_ys.add(a.y);
+				
+				if (a.y == b.y) continue; // Horizontal edges never contribute to a span.
+				
+				Edge edge;
+				edge.winding = (a.y < b.y) ? 1 : -1;
+				if (a.y > b.y) { vec2 t = a; a = b; b = t; }
+				edge.x0 = a.x; edge.y0 = a.y;
+				edge.x1 = b.x; edge.y1 = b.y;
+				edge.dxdy = (b.x - a.x) / (b.y - a.y);
+				edges.add(edge);
+			}
+		}
+		
+		if (edges.count == 0) return;
+		
+		sort_edges_by_top(edges.data, edges.count);
+		sort_floats(band_ys.data, band_ys.count);
+		
+		active.count = 0;
+		int32_t next_edge = 0;
+		int32_t next_y = 0;
+		
+		float y_top = band_ys[0];
+		
+		while (true) {
+			// Find the next band boundary coming from the vertices.
+			while (next_y < band_ys.count && band_ys[next_y] <= y_top) next_y += 1;
+			if (next_y >= band_ys.count) break;
+			float y_bottom = band_ys[next_y];
+			
+			// Drop edges that ended and pick up edges that start at this band.
+			int32_t kept = 0;
+			for (int32_t i = 0; i < active.count; i += 1) {
+				if (active[i].edge->y1 > y_top) active[kept++] = active[i];
+			}
+			active.count = kept;
+			
+			while (next_edge < edges.count && edges[next_edge].y0 <= y_top) {
+				Edge* edge = &edges[next_edge++];
+				if (edge->y1 > y_top) active.add({edge, 0, 0});
+			}
+			
+			for (int32_t i = 0; i < active.count; i += 1) {
+				active[i].x_top = active[i].edge->x_at(y_top);
+				active[i].x_bottom = active[i].edge->x_at(y_bottom);
+			}
+			sort_active(active.data, active.count);
+			
+			// If two neighbouring edges swap order inside the band, they intersect. Cut the band at the first intersection.
+			for (int32_t i = 0; i + 1 < active.count; i += 1) {
+				ActiveEdge* a = &active[i];
+				ActiveEdge* b = &active[i + 1];
+				if (a->x_bottom <= b->x_bottom) continue;
+				
+				float slope_difference = a->edge->dxdy - b->edge->dxdy;
+				if (slope_difference == 0) continue;
+				
+				float y = y_top + (b->x_top - a->x_top) / slope_difference;
+				float min_step = (y_bottom - y_top) * (1.0f / 1024);
+				if (y < y_top + min_step) y = y_top + min_step; // Don't let numerical noise stall the sweep.
+				if (y < y_bottom) y_bottom = y;
+			}
+			
+			for (int32_t i = 0; i < active.count; i += 1) {
+				active[i].x_bottom = active[i].edge->x_at(y_bottom);
+			}
+			
+			int32_t winding = 0;
+			for (int32_t i = 0; i + 1 < active.count; i += 1) {
+				winding += active[i].edge->winding;
+				if (!inside(winding, rule)) continue;
+				
+				ActiveEdge* left = &active[i];
+				ActiveEdge* right = &active[i + 1];
+				
+				uint32_t a = emit_vertex({left->x_top, y_top}, 1);
+				uint32_t b = emit_vertex({right->x_top, y_top}, 1);
+				uint32_t c = emit_vertex({right->x_bottom, y_bottom}, 1);
+				uint32_t d = emit_vertex({left->x_bottom, y_bottom}, 1);
+				emit_quad(a, b, c, d);
+			}
+			
+			y_top = y_bottom;
+		}
+	}
+	
+	static void fill_fringe(float fringe) {
+		// The fringe goes outwards from each contour, using the contour winding to tell outside from inside.
+		// #incomplete: This assumes holes are wound opposite to their outlines, which is the usual convention. Same-direction holes with NON_ZERO get their fringe on the wrong side.
+		
+		for (int32_t c = 0; c < contours.count; c += 1) {
+			Contour contour = contours[c];
+			int32_t n = contour.point_count;
+			if (n < 3) continue;
+			
+			vec2* points = &flat_points[contour.first_point];
+			
+			float area = 0;
+			for (int32_t i = 0; i < n; i += 1) area += cross(points[i], points[(i + 1) % n]);
+			float outward = (area > 0) ? -1.0f : 1.0f; // perpendicular() points left, which is inside for counter-clockwise contours.
+			
+			uint32_t first_inner = 0, first_outer = 0;
+			uint32_t previous_inner = 0, previous_outer = 0;
+			
+			for (int32_t i = 0; i < n; i += 1) {
+				vec2 p = points[i];
+				vec2 n0 = perpendicular(normalize(p - points[(i + n - 1) % n])) * outward;
+				vec2 n1 = perpendicular(normalize(points[(i + 1) % n] - p)) * outward;
+				
+				vec2 m = (n0 + n1) * 0.5f;
+				float d = dot(m, m);
+				if (d > 1e-6f) m = m * (1.0f / (d > 0.25f ? d : 0.25f)); // Limit the miter so sharp corners don't spike.
+				
+				uint32_t inner = emit_vertex(p, 1);
+				uint32_t outer = emit_vertex(p + m * fringe, 0);
+				
+				if (i == 0) {
+					first_inner = inner;
+					first_outer = outer;
+				} else {
+					emit_quad(previous_inner, previous_outer, outer, inner);
+				}
+				
+				previous_inner = inner;
+				previous_outer = outer;
+			}
+			
+			emit_quad(previous_inner, previous_outer, first_outer, first_inner);
+		}
+	}
+	
+	//
+	// Stroke
+	//
+	// Strokes are built as a strip of rows. Each row has four vertices across the stroke: left fringe, left edge, right edge and right fringe.
+	// Joins and caps are just more rows, so the antialiasing fringe follows the outline everywhere without special cases.
+	//
+	
+	struct StrokeContext {
+		float half_width;
+		float fringe;
+		float tolerance;
+		float miter_limit;
+		LineJoin join;
+		LineCap cap;
+		
+		bool has_previous_row;
+		uint32_t previous[4];
+		uint32_t first[4];
+	};
+	
+	static void stroke_row(StrokeContext* context, vec2 left, vec2 right, vec2 left_out, vec2 right_out, float alpha = 1) {
+		uint32_t row[4];
+		row[0] = emit_vertex(left + left_out * context->fringe, 0);
+		row[1] = emit_vertex(left, alpha);
+		row[2] = emit_vertex(right, alpha);
+		row[3] = emit_vertex(right + right_out * context->fringe, 0);
+		
+		if (context->has_previous_row) {
+			for (int k = 0; k < 3; k += 1) {
+				emit_quad(context->previous[k], context->previous[k + 1], row[k + 1], row[k]);
+			}
+		} else {
+			memcpy(context->first, row, sizeof(row));
+		}
+		
+		memcpy(context->previous, row, sizeof(row));
+		context->has_previous_row = true;
+	}
+	
+	static int32_t arc_segments(StrokeContext* context, float angle) {
+		// Same idea as the curve flattening: pick the step so the chord never drifts more than the tolerance from the circle.
+		float radius = context->half_width;
+		float ratio = 1 - context->tolerance / radius;
+		float step = (ratio > -1) ? 2 * acosf(clamp(ratio, -1.0f, 1.0f)) : 3.14159265f;
+		if (step < 0.01f) step = 0.01f;
+		
+		int32_t segments = (int32_t) ceilf(fabsf(angle) / step);
+		return clamp(segments, 1, 64);
+	}
+	
+	static void stroke_cap(StrokeContext* context, vec2 p, vec2 direction, bool is_start) {
+		// 'direction' points away from the stroke, out of the cap.
+		vec2 normal = perpendicular(direction);
+		float h = context->half_width;
+		float f = context->fringe;
+		
+		// Rows always go along the stroke, so the left side of the row flips between the start cap and the end cap.
+		float side = is_start ? -1.0f : 1.0f;
+		
+		switch (context->cap) {
+		  case LineCap::BUTT:
+		  case LineCap::SQUARE: {
+				vec2 base = p;
+				if (context->cap == LineCap::SQUARE) base = base + direction * h;
+				
+				vec2 left = base + normal * (h * side);
+				vec2 right = base - normal * (h * side);
+				vec2 out = direction * f;
+				
+				if (is_start) {
+					stroke_row(context, left + out, right + out, normal * side, -normal * side, 0);
+					stroke_row(context, left, right, normal * side, -normal * side);
+				} else {
+					stroke_row(context, left, right, normal * side, -normal * side);
+					stroke_row(context, left + out, right + out, normal * side, -normal * side, 0);
+				}
+			} break;
+		
+		  case LineCap::ROUND: {
+				int32_t segments = arc_segments(context, 3.14159265f * 0.5f);
+				for (int32_t i = 0; i <= segments; i += 1) {
+					// At the start we walk from the tip of the cap back to the stroke, at the end we walk from the stroke to the tip.
+					int32_t k = is_start ? i : segments - i;
+					float angle = (float) k / segments * 3.14159265f * 0.5f;
+					
+					vec2 back = direction * (h * cosf(angle));
+					vec2 across = normal * (h * sinf(angle) * side);
+					
+					vec2 left = p + back + across;
+					vec2 right = p + back - across;
+					stroke_row(context, left, right, normalize(left - p), normalize(right - p));
+				}
+			} break;
+		
+		  default: paintbox_assert(false);
+		}
+	}
+	
+	static void stroke_join(StrokeContext* context, vec2 p, vec2 d0, vec2 d1) {
+		float h = context->half_width;
+		
+		vec2 n0 = perpendicular(d0);
+		vec2 n1 = perpendicular(d1);
+		vec2 m = normalize(n0 + n1);
+		float cosine = dot(m, n0);
+		
+		if (cosine < 1e-4f) {
+			// The stroke turned back on itself: the miter is infinite, so just cut across.
+			stroke_row(context, p + n0 * h, p - n0 * h, n0, -n0);
+			stroke_row(context, p + n1 * h, p - n1 * h, n1, -n1);
+			return;
+		}
+		
+		float miter_ratio = 1 / cosine;
+		
+		if (context->join == LineJoin::MITER && miter_ratio <= context->miter_limit) {
+			stroke_row(context, p + m * (h * miter_ratio), p - m * (h * miter_ratio), m, -m);
+			return;
+		}
+		
+		// Bevel and round joins keep the miter point on the inner side and walk around the outer side.
+		float inner_length = h * (miter_ratio < context->miter_limit ? miter_ratio : context->miter_limit);
+		bool turns_left = cross(d0, d1) > 0;
+		
+		if (context->join == LineJoin::ROUND) {
+			float angle = acosf(clamp(dot(n0, n1), -1.0f, 1.0f));
+			int32_t segments = arc_segments(context, angle);
+			
+			for (int32_t i = 0; i <= segments; i += 1) {
+				float t = (float) i / segments;
+				float a = angle * t * (turns_left ? 1 : -1);
+				vec2 n = {n0.x * cosf(a) - n0.y * sinf(a), n0.x * sinf(a) + n0.y * cosf(a)};
+				
+				if (turns_left) stroke_row(context, p + m * inner_length, p - n * h, m, -n);
+				else            stroke_row(context, p + n * h, p - m * inner_length, n, -m);
+			}
+		} else {
+			if (turns_left) {
+				stroke_row(context, p + m * inner_length, p - n0 * h, m, -n0);
+				stroke_row(context, p + m * inner_length, p - n1 * h, m, -n1);
+			} else {
+				stroke_row(context, p + n0 * h, p - m * inner_length, n0, -m);
+				stroke_row(context, p + n1 * h, p - m * inner_length, n1, -m);
+			}
+		}
+	}
+	
+	static void stroke_contours(PathStyle* style, float scale) {
+		StrokeContext context = {};
+		context.half_width = style->stroke_width * 0.5f;
+		context.fringe = style->feather / scale;
+		context.tolerance = style->tolerance / scale;
+		context.miter_limit = style->miter_limit;
+		context.join = style->line_join;
+		context.cap = style->line_cap;
+		
+		for (int32_t c = 0; c < contours.count; c += 1) {
+			Contour contour = contours[c];
+			int32_t n = contour.point_count;
+			if (n < 2) continue;
+			
+			vec2* points = &flat_points[contour.first_point];
+			context.has_previous_row = false;
+			
+			if (contour.closed && n >= 3) {
+				for (int32_t i = 0; i < n; i += 1) {
+					vec2 d0 = normalize(points[i] - points[(i + n - 1) % n]);
+					vec2 d1 = normalize(points[(i + 1) % n] - points[i]);
+					stroke_join(&context, points[i], d0, d1);
+				}
+				
+				// Connect the last row back to the first one.
+				for (int k = 0; k < 3; k += 1) {
+					emit_quad(context.previous[k], context.previous[k + 1], context.first[k + 1], context.first[k]);
+				}
+			} else {
+				stroke_cap(&context, points[0], normalize(points[0] - points[1]), true);
+				
+				for (int32_t i = 1; i + 1 < n; i += 1) {
+					vec2 d0 = normalize(points[i] - points[i - 1]);
+					vec2 d1 = normalize(points[i + 1] - points[i]);
+					stroke_join(&context, points[i], d0, d1);
+				}
+				
+				stroke_cap(&context, points[n - 1], normalize(points[n - 1] - points[n - 2]), false);
+			}
+		}
+	}
+	
+	//
+	// Cache
+	//
+	
+	struct CacheEntry {
+		uint64_t key = 0;
+		Vertex* vertices = nullptr;
+		uint32_t* indices = nullptr;
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+	};
+	
+	// #temporary: When the table fills up we throw everything away. Static art gets re-tessellated once and then stays cached; an LRU would be nicer.
+	constexpr int32_t path_cache_capacity = 4096; // Must be a power of two.
+	static int32_t path_cache_count;
+	static CacheEntry path_cache[path_cache_capacity];
+	
+	enum PathOperation : uint64_t {
+		PATH_OPERATION_FILL = 1,
+		PATH_OPERATION_STROKE = 2,
+	};
+	
+	static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+		// FNV-1a
+		auto bytes = (const uint8_t*) data;
+		for (size_t i = 0; i < size; i += 1) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+	
+	static uint64_t hash_path(Path* path, PathStyle* style, int32_t scale_bucket, PathOperation operation) {
+		uint64_t hash = 14695981039346656037ull;
+		hash = hash_bytes(hash, &operation, sizeof(operation));
+		hash = hash_bytes(hash, &scale_bucket, sizeof(scale_bucket));
+		hash = hash_bytes(hash, path->verbs, path->verb_count * sizeof(PathVerb));
+		hash = hash_bytes(hash, path->points, path->point_count * sizeof(vec2));
+		
+		// Hash the style field by field, so padding bytes don't leak into the key.
+		hash = hash_bytes(hash, &style->color, sizeof(style->color));
+		hash = hash_bytes(hash, &style->z, sizeof(style->z));
+		hash = hash_bytes(hash, &style->feather, sizeof(style->feather));
+		hash = hash_bytes(hash, &style->tolerance, sizeof(style->tolerance));
+		
+		if (operation == PATH_OPERATION_FILL) {
+			int32_t rule = (int32_t) style->fill_rule;
+			hash = hash_bytes(hash, &rule, sizeof(rule));
+		} else {
+			int32_t join = (int32_t) style->line_join;
+			int32_t cap = (int32_t) style->line_cap;
+			hash = hash_bytes(hash, &style->stroke_width, sizeof(style->stroke_width));
+			hash = hash_bytes(hash, &style->miter_limit, sizeof(style->miter_limit));
+			hash = hash_bytes(hash, &join, sizeof(join));
+			hash = hash_bytes(hash, &cap, sizeof(cap));
+		}
+		
+		if (hash == 0) hash = 1; // Zero marks empty slots.
+		return hash;
+	}
+	
+	void path_cache_flush() {
+		for (int32_t i = 0; i < path_cache_capacity; i += 1) {
+			free(path_cache[i].vertices);
+			free(path_cache[i].indices);
+			path_cache[i] = {};
+		}
+		path_cache_count = 0;
+	}
+	
+	static CacheEntry* path_cache_find(uint64_t key) {
+		// Linear probing. Keys are full 64-bit hashes, so we treat a key match as a path match.
+		for (int32_t i = 0; i < path_cache_capacity; i += 1) {
+			CacheEntry* entry = &path_cache[(key + i) & (path_cache_capacity - 1)];
+			if (entry->key == key || entry->key == 0) return entry;
+		}
+		return nullptr;
+	}
+	
+	static void append_to_batch(Batch* batch, Vertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count) {
+		batch_reserve(batch, vertex_count, index_count);
+		
+		uint32_t base = batch->vertex_count;
+		memcpy(batch->vertices + base, vertices, vertex_count * sizeof(Vertex));
+		for (uint32_t i = 0; i < index_count; i += 1) {
+			batch->indices[batch->index_count + i] = indices[i] + base;
+		}
+		
+		batch->vertex_count += vertex_count;
+		batch->index_count += index_count;
+	}
+	
+	static void path_tessellate(Path* path, PathStyle* style, float scale, Batch* batch, PathOperation operation) {
+		if (path->verb_count == 0) return;
+		paintbox_assert(scale > 0);
+		
+		// Quantize the scale to quarter octaves, so small zoom changes (and float noise in transforms) still hit the cache.
+		int32_t scale_bucket = (int32_t) floorf(log2f(scale) * 4 + 0.5f);
+		float bucket_scale = exp2f(scale_bucket * 0.25f);
+		
+		uint64_t key = hash_path(path, style, scale_bucket, operation);
+		
+		CacheEntry* entry = path_cache_find(key);
+		if (entry && entry->key == key) {
+			append_to_batch(batch, entry->vertices, entry->vertex_count, entry->indices, entry->index_count);
+			return;
+		}
+		
+		out_vertices.count = 0;
+		out_indices.count = 0;
+		out_color = style->color;
+		out_z = style->z;
+		
+		flatten_path(path, style->tolerance / bucket_scale);
+		
+		if (operation == PATH_OPERATION_FILL) {
+			fill_interior(style->fill_rule);
+			if (style->feather > 0) fill_fringe(style->feather / bucket_scale);
+		} else {
+			stroke_contours(style, bucket_scale);
+		}
+		
+		// Degenerate paths (a lone move_to, or a fill with no area) give no triangles. They're cheap to redo, and caching them would mean malloc(0).
+		if (out_indices.count == 0) return;
+		
+		append_to_batch(batch, out_vertices.data, out_vertices.count, out_indices.data, out_indices.count);
+		
+		if (path_cache_count + 1 > path_cache_capacity * 3 / 4) {
+			path_cache_flush();
+			entry = path_cache_find(key);
+		}
+		
+		entry->key = key;
+		entry->vertex_count = out_vertices.count;
+		entry->index_count = out_indices.count;
+		entry->vertices = (Vertex*) malloc(out_vertices.count * sizeof(Vertex));
+		entry->indices = (uint32_t*) malloc(out_indices.count * sizeof(uint32_t));
+		paintbox_assert(entry->vertices && entry->indices);
+		memcpy(entry->vertices, out_vertices.data, out_vertices.count * sizeof(Vertex));
+		memcpy(entry->indices, out_indices.data, out_indices.count * sizeof(uint32_t));
+		path_cache_count += 1;
+	}
+	
+	void path_fill(Path* path, PathStyle* style, float scale, Batch* batch) {
+		path_tessellate(path, style, scale, batch, PATH_OPERATION_FILL);
+	}
+	
+	void path_stroke(Path* path, PathStyle* style, float scale, Batch* batch) {
+		path_tessellate(path, style, scale, batch, PATH_OPERATION_STROKE);
+	}
+
+}
\ No newline at end of file
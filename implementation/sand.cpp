@@ -0,0 +1,310 @@
+#include "paintbox.h"
+
+#include <atomic>
+#include <limits.h> // For INT32_MAX.
+#include <string.h> // For memset.
+
+namespace Paintbox {
+	
+	struct Cell {
+		CellType type;
+		uint8_t shade; // Small random variation, so the materials don't look flat.
+		uint8_t clock; // Step tag of the last time this cell moved. Keeps a cell from moving twice when it falls into a chunk that updates later in the same step.
+		uint8_t unused;
+	};
+	
+	static_assert(sizeof(Cell) == 4, "Cells should stay small, there are millions of them.");
+	
+	// Rectangle of cells that several threads can grow at the same time. Max is exclusive; the rectangle is empty when min >= max.
+	struct AtomicRect {
+		std::atomic<int32_t> min_x {INT32_MAX};
+		std::atomic<int32_t> min_y {INT32_MAX};
+		std::atomic<int32_t> max_x {INT32_MIN};
+		std::atomic<int32_t> max_y {INT32_MIN};
+	};
+	
+	struct SandRect {
+		int32_t min_x, min_y, max_x, max_y;
+		
+		bool empty() { return min_x >= max_x || min_y >= max_y; }
+	};
+	
+	static void atomic_min(std::atomic<int32_t>* target, int32_t value) {
+		int32_t current = target->load(std::memory_order_relaxed);
+		while (value < current && !target->compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+	
+	static void atomic_max(std::atomic<int32_t>* target, int32_t value) {
+		int32_t current = target->load(std::memory_order_relaxed);
+		while (value > current && !target->compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+	
+	static void rect_include(AtomicRect* rect, int32_t min_x, int32_t min_y, int32_t max_x, int32_t max_y) {
+		atomic_min(&rect->min_x, min_x);
+		atomic_min(&rect->min_y, min_y);
+		atomic_max(&rect->max_x, max_x);
+		atomic_max(&rect->max_y, max_y);
+	}
+	
+	static SandRect rect_take(AtomicRect* rect) {
+		SandRect result;
+		result.min_x = rect->min_x.exchange(INT32_MAX, std::memory_order_relaxed);
+		result.min_y = rect->min_y.exchange(INT32_MAX, std::memory_order_relaxed);
+		result.max_x = rect->max_x.exchange(INT32_MIN, std::memory_order_relaxed);
+		result.max_y = rect->max_y.exchange(INT32_MIN, std::memory_order_relaxed);
+		return result;
+	}
+	
+	struct SandChunk {
+		SandRect active;   // Cells simulated by the current step.
+		AtomicRect next;   // Cells the next step needs to look at.
+		AtomicRect dirty;  // Cells changed since the last sand_upload.
+	};
+	
+	struct SandWorldImpl : SandWorld {
+		Cell* cells = nullptr;
+		uint32_t* pixels = nullptr; // RGBA8, the source for the texture uploads.
+		
+		int32_t chunk_columns = 0;
+		int32_t chunk_rows = 0;
+		SandChunk* chunks = nullptr;
+		
+		int32_t* pass_chunks = nullptr; // Scratch list of the chunks that update in the current pass.
+		uint8_t clock = 0;
+	};
+	
+	//
+	// Cells
+	//
+	
+	static uint32_t cell_color(Cell cell) {
+		uint32_t r = 0, g = 0, b = 0, a = 0;
+		
+		switch (cell.type) {
+		  case CellType::EMPTY: break;
+		  case CellType::SAND:  r = 220; g = 190; b = 120; a = 255; break;
+		  case CellType::WATER: r = 50;  g = 100; b = 220; a = 200; break;
+		  case CellType::STONE: r = 120; g = 120; b = 125; a = 255; break;
+		  default: paintbox_assert(false);
+		}
+		
+		r = r > cell.shade ? r - cell.shade : 0;
+		g = g > cell.shade ? g - cell.shade : 0;
+		b = b > cell.shade ? b - cell.shade : 0;
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+	
+	static uint32_t hash(int32_t x, int32_t y, uint64_t step) {
+		uint32_t h = (uint32_t) x * 73856093u ^ (uint32_t) y * 19349663u ^ (uint32_t) step * 83492791u;
+		h ^= h >> 13;
+		h *= 0x5bd1e995u;
+		h ^= h >> 15;
+		return h;
+	}
+	
+	static SandChunk* chunk_at(SandWorldImpl* world, int32_t x, int32_t y) {
+		return &world->chunks[(y / sand_chunk_size) * world->chunk_columns + (x / sand_chunk_size)];
+	}
+	
+	static void wake_around(SandWorldImpl* world, int32_t x, int32_t y) {
+		// Whatever happens to a cell can make its 8 neighbours move next step, and some of them may live in other chunks.
+		int32_t min_x = x > 0 ? x - 1 : 0;
+		int32_t min_y = y > 0 ? y - 1 : 0;
+		int32_t max_x = x + 1 < world->width ? x + 2 : world->width;
+		int32_t max_y = y + 1 < world->height ? y + 2 : world->height;
+		
+		for (int32_t cy = min_y / sand_chunk_size; cy <= (max_y - 1) / sand_chunk_size; cy += 1) {
+			for (int32_t cx = min_x / sand_chunk_size; cx <= (max_x - 1) / sand_chunk_size; cx += 1) {
+				int32_t chunk_min_x = cx * sand_chunk_size;
+				int32_t chunk_min_y = cy * sand_chunk_size;
+				
+				SandChunk* chunk = &world->chunks[cy * world->chunk_columns + cx];
+				rect_include(&chunk->next,
+					min_x > chunk_min_x ? min_x : chunk_min_x,
+					min_y > chunk_min_y ? min_y : chunk_min_y,
+					max_x < chunk_min_x + sand_chunk_size ? max_x : chunk_min_x + sand_chunk_size,
+					max_y < chunk_min_y + sand_chunk_size ? max_y : chunk_min_y + sand_chunk_size);
+			}
+		}
+	}
+	
+	static void write_cell(SandWorldImpl* world, int32_t x, int32_t y, Cell cell) {
+		int32_t index = y * world->width + x;
+		world->cells[index] = cell;
+		world->pixels[index] = cell_color(cell);
+		
+		rect_include(&chunk_at(world, x, y)->dirty, x, y, x + 1, y + 1);
+		wake_around(world, x, y);
+	}
+	
+	//
+	// Simulation
+	//
+	
+	static bool can_displace(SandWorldImpl* world, int32_t x, int32_t y, CellType mover) {
+		if (x < 0 || y < 0 || x >= world->width || y >= world->height) return false;
+		
+		CellType target = world->cells[y * world->width + x].type;
+		if (target == CellType::EMPTY) return true;
+		if (mover == CellType::SAND && target == CellType::WATER) return true; // Sand sinks in water.
+		return false;
+	}
+	
+	static void swap_cells(SandWorldImpl* world, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+		Cell a = world->cells[y0 * world->width + x0];
+		Cell b = world->cells[y1 * world->width + x1];
+		a.clock = world->clock;
+		b.clock = world->clock;
+		write_cell(world, x0, y0, b);
+		write_cell(world, x1, y1, a);
+	}
+	
+	static void update_cell(SandWorldImpl* world, int32_t x, int32_t y) {
+		Cell cell = world->cells[y * world->width + x];
+		if (cell.type == CellType::EMPTY || cell.type == CellType::STONE) return;
+		if (cell.clock == world->clock) return;
+		
+		// Gravity points towards y = 0, which is also the first row of the texture.
+		int32_t side = (hash(x, y, world->step_count) & 1) ? 1 : -1;
+		
+		if (can_displace(world, x, y - 1, cell.type)) {
+			swap_cells(world, x, y, x, y - 1);
+		} else if (can_displace(world, x + side, y - 1, cell.type)) {
+			swap_cells(world, x, y, x + side, y - 1);
+		} else if (can_displace(world, x - side, y - 1, cell.type)) {
+			swap_cells(world, x, y, x - side, y - 1);
+		} else if (cell.type == CellType::WATER) {
+			if (can_displace(world, x + side, y, cell.type)) {
+				swap_cells(world, x, y, x + side, y);
+			} else if (can_displace(world, x - side, y, cell.type)) {
+				swap_cells(world, x, y, x - side, y);
+			}
+		}
+	}
+	
+	static void update_chunk(int32_t index, void* user_data) {
+		auto world = (SandWorldImpl*) user_data;
+		SandChunk* chunk = &world->chunks[world->pass_chunks[index]];
+		SandRect rect = chunk->active;
+		
+		// Alternate the horizontal direction every step, otherwise everything drifts to one side.
+		bool left_to_right = (world->step_count & 1) == 0;
+		
+		for (int32_t y = rect.min_y; y < rect.max_y; y += 1) {
+			if (left_to_right) {
+				for (int32_t x = rect.min_x; x < rect.max_x; x += 1) update_cell(world, x, y);
+			} else {
+				for (int32_t x = rect.max_x - 1; x >= rect.min_x; x -= 1) update_cell(world, x, y);
+			}
+		}
+	}
+	
+	//
+	// API
+	//
+	
+	SandWorld* sand_world_create(int32_t width, int32_t height) {
+		paintbox_assert(width > 0 && height > 0);
+		paintbox_assert_log(width % sand_chunk_size == 0 && height % sand_chunk_size == 0, "Sand worlds must be a multiple of %d cells on each side, not %d by %d.", sand_chunk_size, width, height);
+		
+		SandWorldImpl* world = new SandWorldImpl; // #memory_cleanup
+		world->width = width;
+		world->height = height;
+		
+		world->cells = new Cell[width * height];
+		world->pixels = new uint32_t[width * height];
+		memset(world->cells, 0, width * height * sizeof(Cell));
+		memset(world->pixels, 0, width * height * sizeof(uint32_t));
+		
+		world->chunk_columns = width / sand_chunk_size;
+		world->chunk_rows = height / sand_chunk_size;
+		world->chunks = new SandChunk[world->chunk_columns * world->chunk_rows];
+		world->pass_chunks = new int32_t[world->chunk_columns * world->chunk_rows];
+		
+		for (int32_t i = 0; i < world->chunk_columns * world->chunk_rows; i += 1) {
+			world->chunks[i].active = {0, 0, 0, 0};
+		}
+		
+		world->texture = texture_create(TextureFormat::RGBA_U8, width, height, world->pixels);
+		return world;
+	}
+	
+	void sand_set_cell(SandWorld* world, int32_t x, int32_t y, CellType type) {
+		auto world_impl = (SandWorldImpl*) world;
+		if (x < 0 || y < 0 || x >= world->width || y >= world->height) return;
+		
+		Cell cell = {};
+		cell.type = type;
+		cell.shade = (uint8_t) (hash(x, y, world->step_count) & 31);
+		write_cell(world_impl, x, y, cell);
+	}
+	
+	CellType sand_get_cell(SandWorld* world, int32_t x, int32_t y) {
+		auto world_impl = (SandWorldImpl*) world;
+		if (x < 0 || y < 0 || x >= world->width || y >= world->height) return CellType::EMPTY;
+		return world_impl->cells[y * world->width + x].type;
+	}
+	
+	void sand_paint(SandWorld* world, vec2 center, float radius, CellType type) {
+		int32_t min_x = (int32_t) (center.x - radius);
+		int32_t max_x = (int32_t) (center.x + radius);
+		int32_t min_y = (int32_t) (center.y - radius);
+		int32_t max_y = (int32_t) (center.y + radius);
+		
+		for (int32_t y = min_y; y <= max_y; y += 1) {
+			for (int32_t x = min_x; x <= max_x; x += 1) {
+				float dx = x + 0.5f - center.x;
+				float dy = y + 0.5f - center.y;
+				if (dx * dx + dy * dy <= radius * radius) sand_set_cell(world, x, y, type);
+			}
+		}
+	}
+	
+	void sand_step(SandWorld* world) {
+		auto world_impl = (SandWorldImpl*) world;
+		int32_t chunk_count = world_impl->chunk_columns * world_impl->chunk_rows;
+		
+		// Tags go from 1 to 255, so freshly painted cells (clock 0) are never mistaken for cells that already moved.
+		world_impl->clock = (uint8_t) (world->step_count % 255 + 1);
+		
+		world->awake_chunk_count = 0;
+		for (int32_t i = 0; i < chunk_count; i += 1) {
+			SandChunk* chunk = &world_impl->chunks[i];
+			chunk->active = rect_take(&chunk->next);
+			if (!chunk->active.empty()) world->awake_chunk_count += 1;
+		}
+		
+		// Checkerboard schedule: in each of the four passes, the chunks that update are two chunks apart.
+		// Cells move at most one cell per step, so two chunks of the same pass can never touch the same cell.
+		for (int32_t pass = 0; pass < 4; pass += 1) {
+			int32_t pass_x = pass & 1;
+			int32_t pass_y = pass >> 1;
+			
+			int32_t count = 0;
+			for (int32_t cy = pass_y; cy < world_impl->chunk_rows; cy += 2) {
+				for (int32_t cx = pass_x; cx < world_impl->chunk_columns; cx += 2) {
+					int32_t index = cy * world_impl->chunk_columns + cx;
+					if (!world_impl->chunks[index].active.empty()) world_impl->pass_chunks[count++] = index;
+				}
+			}
+			
+			parallel_for(count, update_chunk, world_impl);
+		}
+		
+		world->step_count += 1;
+	}
+	
+	void sand_upload(SandWorld* world) {
+		auto world_impl = (SandWorldImpl*) world;
+		int32_t chunk_count = world_impl->chunk_columns * world_impl->chunk_rows;
+		
+		for (int32_t i = 0; i < chunk_count; i += 1) {
+			SandRect rect = rect_take(&world_impl->chunks[i].dirty);
+			if (rect.empty()) continue;
+			
+			uint32_t* first_pixel = &world_impl->pixels[rect.min_y * world->width + rect.min_x];
+			texture_update(world->texture, rect.min_x, rect.min_y, rect.max_x - rect.min_x, rect.max_y - rect.min_y, first_pixel, world->width);
+		}
+	}
+
+}
\ No newline at end of file
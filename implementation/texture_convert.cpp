@@ -0,0 +1,317 @@
+#include "paintbox.h"
+
+#include <string.h> // For memcpy.
+
+#if PAINTBOX_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Paintbox {
+	
+	// Images smaller than this are converted on the calling thread, since waking the workers up would take longer.
+	constexpr int32_t parallel_conversion_min_pixels = 256 * 256;
+	constexpr int32_t conversion_rows_per_job = 32;
+	
+	struct TextureConversion {
+		TextureFormat destination_format;
+		uint8_t* destination;
+		uint32_t destination_pitch;
+		
+		TextureFormat source_format;
+		uint8_t* source;
+		uint32_t source_pitch;
+		
+		int32_t width;
+		int32_t height;
+		uint32_t flags;
+	};
+	
+	#if PAINTBOX_SSE2
+	static uint32_t load_u32(const uint8_t* p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+	
+	// float_to_half, four at a time, without the signs, infinities and NaNs that 8 bit unorm values never turn into.
+	static __m128i unorm_float_to_half_sse2(__m128 value) {
+		const __m128i magic_bits = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		
+		__m128i bits = _mm_castps_si128(value);
+		__m128i is_denormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+		
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(value, _mm_castsi128_ps(magic_bits))), magic_bits);
+		
+		__m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(bits, _mm_set1_epi32((int32_t) ((uint32_t) (15 - 127) << 23) + 0xfff));
+		normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissa_odd), 13);
+		
+		return _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+	}
+	#endif
+	
+	//
+	// Kernels
+	// Each one does a row: the SSE2 loop takes the bulk, and the scalar loop after it the pixels that are left.
+	//
+	
+	static void expand_rgb_to_rgba(uint8_t* out, const uint8_t* in, int32_t width) {
+		int32_t x = 0;
+		
+		#if PAINTBOX_SSE2
+		// Four pixels from four overlapping loads. The last one reads a byte past the fourth pixel, so the loop stops one pixel early to stay inside the row.
+		const __m128i alpha = _mm_set1_epi32((int32_t) 0xFF000000);
+		for (; x + 4 < width; x += 4) {
+			const uint8_t* p = in + x * 3;
+			__m128i pixels = _mm_setr_epi32(load_u32(p), load_u32(p + 3), load_u32(p + 6), load_u32(p + 9));
+			_mm_storeu_si128((__m128i*) (out + x * 4), _mm_or_si128(pixels, alpha));
+		}
+		#endif
+		
+		for (; x < width; x += 1) {
+			out[x * 4 + 0] = in[x * 3 + 0];
+			out[x * 4 + 1] = in[x * 3 + 1];
+			out[x * 4 + 2] = in[x * 3 + 2];
+			out[x * 4 + 3] = 255;
+		}
+	}
+	
+	// (c * a + 127) / 255, without the divide. Exact for every c and a.
+	static uint8_t multiply_unorm8(uint32_t c, uint32_t a) {
+		uint32_t product = c * a + 128;
+		return (uint8_t) ((product + (product >> 8)) >> 8);
+	}
+	
+	static void premultiply_alpha(uint8_t* out, const uint8_t* in, int32_t width) {
+		int32_t x = 0;
+		
+		#if PAINTBOX_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+		const __m128i all_255 = _mm_set1_epi16(255);
+		const __m128i all_128 = _mm_set1_epi16(128);
+		
+		for (; x + 4 <= width; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*) (in + x * 4));
+			__m128i halves[2] = {_mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero)};
+			
+			for (int i = 0; i < 2; i += 1) {
+				// Every channel gets multiplied by its pixel's alpha, except alpha itself, which gets multiplied by 255 so it comes out unchanged.
+				__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves[i], _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+				alpha = _mm_or_si128(_mm_andnot_si128(alpha_lanes, alpha), _mm_and_si128(alpha_lanes, all_255));
+				
+				__m128i product = _mm_add_epi16(_mm_mullo_epi16(halves[i], alpha), all_128);
+				halves[i] = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+			}
+			
+			_mm_storeu_si128((__m128i*) (out + x * 4), _mm_packus_epi16(halves[0], halves[1]));
+		}
+		#endif
+		
+		for (; x < width; x += 1) {
+			uint8_t a = in[x * 4 + 3];
+			out[x * 4 + 0] = multiply_unorm8(in[x * 4 + 0], a);
+			out[x * 4 + 1] = multiply_unorm8(in[x * 4 + 1], a);
+			out[x * 4 + 2] = multiply_unorm8(in[x * 4 + 2], a);
+			out[x * 4 + 3] = a;
+		}
+	}
+	
+	// 0..255 to -127..127, so the shader reads 2 * unorm - 1. Never lands exactly on a half, so the SSE2 rounding (to even) and ours agree.
+	static void convert_u8_to_s8(int8_t* out, const uint8_t* in, int32_t count) {
+		const float scale = 127.0f / 255.0f;
+		int32_t i = 0;
+		
+		#if PAINTBOX_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale4 = _mm_set1_ps(scale);
+		const __m128i all_255 = _mm_set1_epi32(255);
+		
+		for (; i + 16 <= count; i += 16) {
+			__m128i bytes = _mm_loadu_si128((const __m128i*) (in + i));
+			__m128i shorts[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+			
+			__m128i words[4];
+			for (int j = 0; j < 4; j += 1) {
+				__m128i ints = (j & 1) ? _mm_unpackhi_epi16(shorts[j / 2], zero) : _mm_unpacklo_epi16(shorts[j / 2], zero);
+				__m128i centered = _mm_sub_epi32(_mm_add_epi32(ints, ints), all_255);
+				words[j] = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(centered), scale4));
+			}
+			
+			__m128i packed = _mm_packs_epi16(_mm_packs_epi32(words[0], words[1]), _mm_packs_epi32(words[2], words[3]));
+			_mm_storeu_si128((__m128i*) (out + i), packed);
+		}
+		#endif
+		
+		for (; i < count; i += 1) {
+			float value = (2 * (int32_t) in[i] - 255) * scale;
+			out[i] = (int8_t) (value < 0 ? value - 0.5f : value + 0.5f);
+		}
+	}
+	
+	static void convert_u8_to_f16(uint16_t* out, const uint8_t* in, int32_t width, bool premultiply) {
+		const float scale = 1.0f / 255.0f;
+		int32_t x = 0;
+		
+		#if PAINTBOX_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 scale4 = _mm_set1_ps(scale);
+		const __m128 alpha_lane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+		const __m128 one = _mm_set1_ps(1);
+		
+		for (; x + 4 <= width; x += 4) {
+			__m128i bytes = _mm_loadu_si128((const __m128i*) (in + x * 4));
+			__m128i shorts[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+			
+			// One pixel per register.
+			__m128i halves[4];
+			for (int j = 0; j < 4; j += 1) {
+				__m128i ints = (j & 1) ? _mm_unpackhi_epi16(shorts[j / 2], zero) : _mm_unpacklo_epi16(shorts[j / 2], zero);
+				__m128 pixel = _mm_mul_ps(_mm_cvtepi32_ps(ints), scale4);
+				
+				if (premultiply) {
+					// Done in float, so it costs no precision on top of the 8 bit source.
+					__m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+					alpha = _mm_or_ps(_mm_andnot_ps(alpha_lane, alpha), _mm_and_ps(alpha_lane, one));
+					pixel = _mm_mul_ps(pixel, alpha);
+				}
+				
+				halves[j] = unorm_float_to_half_sse2(pixel);
+			}
+			
+			// Halves of values in 0..1 are at most 0x3C00, so the signed saturation never kicks in.
+			_mm_storeu_si128((__m128i*) (out + x * 4), _mm_packs_epi32(halves[0], halves[1]));
+			_mm_storeu_si128((__m128i*) (out + x * 4 + 8), _mm_packs_epi32(halves[2], halves[3]));
+		}
+		#endif
+		
+		for (; x < width; x += 1) {
+			float alpha = in[x * 4 + 3] * scale;
+			float multiplier = premultiply ? alpha : 1;
+			
+			for (int c = 0; c < 3; c += 1) out[x * 4 + c] = float_to_half(in[x * 4 + c] * scale * multiplier);
+			out[x * 4 + 3] = float_to_half(alpha);
+		}
+	}
+	
+	// 'shift' picks the channel: 0 for red, 24 for alpha.
+	static void extract_channel_to_f32(float* out, const uint8_t* in, int32_t width, int32_t shift) {
+		const float scale = 1.0f / 255.0f;
+		int32_t x = 0;
+		
+		#if PAINTBOX_SSE2
+		const __m128 scale4 = _mm_set1_ps(scale);
+		const __m128i low_byte = _mm_set1_epi32(0xFF);
+		const __m128i shift_count = _mm_cvtsi32_si128(shift);
+		
+		for (; x + 4 <= width; x += 4) {
+			__m128i pixels = _mm_loadu_si128((const __m128i*) (in + x * 4));
+			__m128i channel = _mm_and_si128(_mm_srl_epi32(pixels, shift_count), low_byte);
+			_mm_storeu_ps(out + x, _mm_mul_ps(_mm_cvtepi32_ps(channel), scale4));
+		}
+		#endif
+		
+		for (; x < width; x += 1) {
+			out[x] = in[x * 4 + shift / 8] * scale;
+		}
+	}
+	
+	static void extract_rg(uint8_t* out, const uint8_t* in, int32_t width) {
+		int32_t x = 0;
+		
+		#if PAINTBOX_SSE2
+		for (; x + 8 <= width; x += 8) {
+			__m128i a = _mm_loadu_si128((const __m128i*) (in + x * 4));
+			__m128i b = _mm_loadu_si128((const __m128i*) (in + x * 4 + 16));
+			
+			// Keep the low 16 bits of every pixel. Sign extending them first makes the signed pack give them back unchanged.
+			a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+			b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+			_mm_storeu_si128((__m128i*) (out + x * 2), _mm_packs_epi32(a, b));
+		}
+		#endif
+		
+		for (; x < width; x += 1) {
+			out[x * 2 + 0] = in[x * 4 + 0];
+			out[x * 2 + 1] = in[x * 4 + 1];
+		}
+	}
+	
+	//
+	// Rows
+	//
+	
+	static void texture_convert_rows(int32_t job_index, void* user_data) {
+		auto conversion = (TextureConversion*) user_data;
+		int32_t width = conversion->width;
+		
+		int32_t first_row = job_index * conversion_rows_per_job;
+		int32_t end_row = first_row + conversion_rows_per_job;
+		if (end_row > conversion->height) end_row = conversion->height;
+		
+		bool premultiply = (conversion->flags & TEXTURE_CONVERT_PREMULTIPLY_ALPHA) != 0;
+		bool to_rgba_u8 = conversion->destination_format == TextureFormat::RGBA_U8;
+		
+		// Every conversion goes through RGBA_U8. RGBA_U8 sources are read in place, and when RGBA_U8 is also the destination, the row is built right where it belongs.
+		uint8_t* scratch = nullptr;
+		if (!to_rgba_u8 && conversion->source_format == TextureFormat::RGB_U8) {
+			scratch = (uint8_t*) malloc(width * 4);
+			paintbox_assert(scratch);
+		}
+		
+		for (int32_t y = first_row; y < end_row; y += 1) {
+			uint8_t* source_row = conversion->source + y * conversion->source_pitch;
+			uint8_t* destination_row = conversion->destination + y * conversion->destination_pitch;
+			uint8_t* rgba = to_rgba_u8 ? destination_row : scratch;
+			
+			if (conversion->source_format == TextureFormat::RGB_U8) {
+				expand_rgb_to_rgba(rgba, source_row, width);
+			} else if (to_rgba_u8 && !premultiply) {
+				memcpy(rgba, source_row, width * 4);
+			} else {
+				rgba = source_row; // Read straight from the source.
+			}
+			
+			// F16 premultiplies in float, on its own.
+			if (premultiply && to_rgba_u8) premultiply_alpha(destination_row, rgba, width);
+			
+			switch (conversion->destination_format) {
+			  case TextureFormat::RGBA_U8:   break;
+			  case TextureFormat::RGBA_S8:   convert_u8_to_s8((int8_t*) destination_row, rgba, width * 4); break;
+			  case TextureFormat::RGBA_F16:  convert_u8_to_f16((uint16_t*) destination_row, rgba, width, premultiply); break;
+			  case TextureFormat::ALPHA_F32: extract_channel_to_f32((float*) destination_row, rgba, width, conversion->source_format == TextureFormat::RGB_U8 ? 0 : 24); break;
+			  case TextureFormat::RG_U8:     extract_rg(destination_row, rgba, width); break;
+			  default: paintbox_assert(false);
+			}
+		}
+		
+		free(scratch);
+	}
+	
+	void texture_convert(TextureFormat destination_format, void* destination, TextureFormat source_format, void* source, int32_t width, int32_t height, uint32_t flags) {
+		paintbox_assert_log(source_format == TextureFormat::RGBA_U8 || source_format == TextureFormat::RGB_U8, "texture_convert() only takes RGBA_U8 and RGB_U8 sources, not format %d.", (int) source_format);
+		
+		bool premultiply = (flags & TEXTURE_CONVERT_PREMULTIPLY_ALPHA) != 0;
+		paintbox_assert(!premultiply || destination_format == TextureFormat::RGBA_U8 || destination_format == TextureFormat::RGBA_F16);
+		
+		TextureConversion conversion;
+		conversion.destination_format = destination_format;
+		conversion.destination = (uint8_t*) destination;
+		conversion.destination_pitch = texture_level_size(destination_format, width, 1);
+		conversion.source_format = source_format;
+		conversion.source = (uint8_t*) source;
+		conversion.source_pitch = texture_level_size(source_format, width, 1);
+		conversion.width = width;
+		conversion.height = height;
+		conversion.flags = flags;
+		
+		int32_t job_count = (height + conversion_rows_per_job - 1) / conversion_rows_per_job;
+		
+		if (width * height < parallel_conversion_min_pixels) {
+			for (int32_t i = 0; i < job_count; i += 1) texture_convert_rows(i, &conversion);
+		} else {
+			parallel_for(job_count, texture_convert_rows, &conversion);
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "paintbox.h"
+
+namespace Paintbox {
+	
+	struct TextureStreamImpl : TextureStream {
+		MappedFile file;
+		TextureFileHeader* header = nullptr;
+	};
+	
+	uint32_t texture_level_size(TextureFormat format, int32_t width, int32_t height) {
+		uint32_t blocks_x = (width + 3) / 4;
+		uint32_t blocks_y = (height + 3) / 4;
+		
+		switch (format) {
+		  case TextureFormat::RGBA_U8:   return width * height * 4;
+		  case TextureFormat::RGBA_S8:   return width * height * 4;
+		  case TextureFormat::RGBA_F16:  return width * height * 8;
+		  case TextureFormat::ALPHA_F32: return width * height * 4;
+		  case TextureFormat::BC1_RGB:   return blocks_x * blocks_y * 8;
+		  case TextureFormat::BC5_RG:    return blocks_x * blocks_y * 16;
+		  case TextureFormat::RGB_U8:    return width * height * 3;
+		  case TextureFormat::RG_U8:     return width * height * 2;
+		  default: paintbox_assert(false);
+		}
+		return 0;
+	}
+	
+	static const char* texture_file_validate(TextureFileHeader* header, uint64_t file_size) {
+		if (file_size < sizeof(TextureFileHeader)) return "the file is too small";
+		if (header->magic != texture_file_magic) return "this is not a texture file";
+		if (header->version != texture_file_version) return "unsupported version";
+		if (header->header_size != sizeof(TextureFileHeader)) return "unexpected header size";
+		if (header->format == (uint32_t) TextureFormat::NONE || header->format >= (uint32_t) TextureFormat::COUNT) return "unknown texture format";
+		if (header->width <= 0 || header->height <= 0) return "invalid size";
+		if (header->mip_count < 1 || header->mip_count > max_texture_mips) return "invalid mip count";
+		if (((header->width | header->height) >> (header->mip_count - 1)) == 0) return "too many mips for the texture size";
+		
+		for (uint32_t level = 0; level < header->mip_count; level += 1) {
+			TextureFileMip mip = header->mips[level];
+			
+			int32_t width = header->width >> level;
+			int32_t height = header->height >> level;
+			if (width < 1) width = 1;
+			if (height < 1) height = 1;
+			
+			if (mip.size != texture_level_size((TextureFormat) header->format, width, height)) return "mip size doesn't match the texture size";
+			if (mip.offset % texture_file_alignment != 0 || mip.offset > file_size || mip.size > file_size - mip.offset) return "mip out of bounds";
+		}
+		
+		return nullptr;
+	}
+	
+	TextureStream* texture_stream_open(const char* path) {
+		MappedFile file;
+		if (!file_map(path, &file)) {
+			paintbox_log("Failed to open texture file '%s'.", path);
+			return nullptr;
+		}
+		
+		auto header = (TextureFileHeader*) file.data;
+		
+		const char* error = texture_file_validate(header, file.size);
+		if (error) {
+			paintbox_log("Failed to load texture file '%s': %s.", path, error);
+			file_unmap(&file);
+			return nullptr;
+		}
+		
+		TextureStreamImpl* stream = new TextureStreamImpl;
+		stream->file = file;
+		stream->header = header;
+		stream->texture = texture_allocate((TextureFormat) header->format, header->width, header->height, header->mip_count);
+		stream->levels_left = header->mip_count;
+		
+		// The smallest level is tiny, and having it in means the texture can be sampled from the start.
+		// With a single level there is nothing to stream, so that one waits for the first update like everything else.
+		if (stream->levels_left > 1) texture_stream_update(stream, 0);
+		return stream;
+	}
+	
+	bool texture_stream_update(TextureStream* stream, uint64_t byte_budget) {
+		auto impl = (TextureStreamImpl*) stream;
+		
+		// Always upload at least one level per call, so a tiny budget still makes progress.
+		uint64_t uploaded = 0;
+		while (impl->levels_left > 0) {
+			int32_t level = impl->levels_left - 1;
+			TextureFileMip mip = impl->header->mips[level];
+			if (uploaded > 0 && uploaded + mip.size > byte_budget) break;
+			
+			// The mapped level goes straight to the driver. Pages that haven't been touched yet are read from disk right here.
+			texture_upload_mip(impl->texture, level, (uint8_t*) impl->file.data + mip.offset, (uint32_t) mip.size);
+			uploaded += mip.size;
+			impl->levels_left -= 1;
+		}
+		
+		if (impl->levels_left > 0) return false;
+		
+		file_unmap(&impl->file);
+		delete impl;
+		return true;
+	}
+	
+	Texture* texture_load(const char* path) {
+		TextureStream* stream = texture_stream_open(path);
+		if (!stream) return nullptr;
+		
+		Texture* texture = stream->texture;
+		texture_stream_update(stream, UINT64_MAX);
+		return texture;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "paintbox.h"
+
+#include <string.h> // For memset.
+
+// The instance buffer binding has to match vertex_animation_instance_binding, and the texel layout the one vertex_animation_create writes.
+static const char* glsl_vertex_animation_vertex_shader_source = R"glsl(
+#version 430
+
+layout (location = 0) in vec3 vertex_position; // Replaced by the baked positions.
+layout (location = 1) in vec4 vertex_color;
+layout (location = 2) in vec2 vertex_uv;
+
+uniform mat4 projection;
+uniform float time;
+uniform vec4 constants[4]; // The first one is vertex count, frame count, frames per second, texels per vertex.
+uniform sampler2D texture2;
+
+struct VertexAnimationInstance {
+	vec2 offset;
+	float time_offset;
+	float speed;
+};
+
+layout (std430, binding = 0) readonly buffer VertexAnimationInstances {
+	VertexAnimationInstance instances[];
+};
+
+out vec2 pixel_uv;
+out vec4 pixel_color;
+
+vec4 fetch_texel(int texel) {
+	int width = textureSize(texture2, 0).x;
+	return texelFetch(texture2, ivec2(texel % width, texel / width), 0);
+}
+
+vec3 fetch_position(int frame) {
+	int texels_per_vertex = int(constants[0].w);
+	int first_texel = (frame * int(constants[0].x) + gl_VertexID) * texels_per_vertex;
+	if (texels_per_vertex == 1) return fetch_texel(first_texel).xyz;
+
+	// ALPHA_F32 textures show their only channel as alpha.
+	return vec3(fetch_texel(first_texel).a, fetch_texel(first_texel + 1).a, fetch_texel(first_texel + 2).a);
+}
+
+void main() {
+	VertexAnimationInstance instance = instances[gl_InstanceID];
+
+	int frame_count = int(constants[0].y);
+	float frame = mod((time * instance.speed + instance.time_offset) * constants[0].z, float(frame_count));
+	int frame0 = min(int(frame), frame_count - 1);
+	int frame1 = frame0 + 1 == frame_count ? 0 : frame0 + 1;
+
+	vec3 position = mix(fetch_position(frame0), fetch_position(frame1), fract(frame));
+	position.xy += instance.offset;
+
+	gl_Position = projection * vec4(position, 1);
+	pixel_color = vertex_color;
+	pixel_uv = vertex_uv;
+}
+)glsl";
+
+namespace Paintbox {
+	
+	static_assert(sizeof(VertexAnimationInstance) == 16, "VertexAnimationInstance is uploaded as it is, so it has to match the std430 layout in the shader.");
+	
+	// The smallest GL_MAX_TEXTURE_SIZE that GL 4.3 allows.
+	constexpr int32_t vertex_animation_max_texture_height = 16384;
+	
+	struct VertexAnimationImpl : VertexAnimation {
+		int32_t texels_per_vertex = 0;
+		Buffer* default_instance = nullptr; // Used when vertex_animation_bind gets no instances.
+	};
+	
+	static Shader* vertex_animation_shader;
+	
+	VertexAnimation* vertex_animation_create(TextureFormat format, int32_t vertex_count, int32_t frame_count, vec3 positions[], float frames_per_second) {
+		paintbox_assert_log(format == TextureFormat::RGBA_F16 || format == TextureFormat::ALPHA_F32, "Vertex animations are baked into RGBA_F16 or ALPHA_F32 textures, not format %d.", (int) format);
+		paintbox_assert(vertex_count > 0 && frame_count > 0 && frames_per_second > 0);
+		
+		if (!vertex_animation_shader) {
+			vertex_animation_shader = shader_create(ShaderLanguage::GLSL, ShaderType::VERTEX, glsl_vertex_animation_vertex_shader_source);
+		}
+		
+		int32_t texels_per_vertex = format == TextureFormat::RGBA_F16 ? 1 : 3;
+		int64_t texel_count = (int64_t) vertex_count * frame_count * texels_per_vertex;
+		
+		int32_t width = texel_count < vertex_animation_texture_width ? (int32_t) texel_count : vertex_animation_texture_width;
+		int64_t height = (texel_count + width - 1) / width;
+		paintbox_assert_log(height <= vertex_animation_max_texture_height, "A vertex animation of %d vertices and %d frames doesn't fit in a texture.", vertex_count, frame_count);
+		
+		// The last row is padded with zeros.
+		uint32_t data_size = texture_level_size(format, width, (int32_t) height);
+		void* data = malloc(data_size);
+		paintbox_assert(data);
+		memset(data, 0, data_size);
+		
+		int32_t position_count = vertex_count * frame_count;
+		if (format == TextureFormat::RGBA_F16) {
+			auto halves = (uint16_t*) data;
+			for (int32_t i = 0; i < position_count; i += 1) {
+				halves[i * 4 + 0] = float_to_half(positions[i].x);
+				halves[i * 4 + 1] = float_to_half(positions[i].y);
+				halves[i * 4 + 2] = float_to_half(positions[i].z);
+				halves[i * 4 + 3] = float_to_half(1);
+			}
+		} else {
+			auto floats = (float*) data;
+			for (int32_t i = 0; i < position_count; i += 1) {
+				floats[i * 3 + 0] = positions[i].x;
+				floats[i * 3 + 1] = positions[i].y;
+				floats[i * 3 + 2] = positions[i].z;
+			}
+		}
+		
+		VertexAnimationImpl* animation = new VertexAnimationImpl; // #memory_cleanup
+		animation->texture = texture_create(format, width, (int32_t) height, data);
+		animation->vertex_count = vertex_count;
+		animation->frame_count = frame_count;
+		animation->frames_per_second = frames_per_second;
+		animation->texels_per_vertex = texels_per_vertex;
+		free(data);
+		
+		VertexAnimationInstance instance = {{0, 0}, 0, 1};
+		animation->default_instance = buffer_create(sizeof(instance), &instance);
+		
+		return animation;
+	}
+	
+	void vertex_animation_bind(VertexAnimation* animation, RenderState* state, Buffer* instances, uint32_t instance_count) {
+		auto impl = (VertexAnimationImpl*) animation;
+		
+		if (!instances) {
+			instances = impl->default_instance;
+			instance_count = 1;
+		}
+		paintbox_assert(instance_count * sizeof(VertexAnimationInstance) <= instances->size);
+		
+		state->vertex_shader = vertex_animation_shader;
+		state->texture2 = animation->texture;
+		state->buffers[vertex_animation_instance_binding] = instances;
+		state->instance_count = instance_count;
+		state->constants[0] = vec4((float) animation->vertex_count, (float) animation->frame_count, animation->frames_per_second, (float) impl->texels_per_vertex);
+	}
+
+}
\ No newline at end of file
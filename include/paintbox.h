@@ -21,6 +21,13 @@
 	exit(-1); \
 }
 
+// SSE2 is always there on x64, and MSVC doesn't define __SSE2__, so we look at the target instead.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PAINTBOX_SSE2 1
+#else
+#define PAINTBOX_SSE2 0
+#endif
+
 // Call this macro before creating a resource to have debug information about it.
 #define MARK_NEXT_RESOURCE(name) Paintbox::mark_next_resource(name, __FILE__, __LINE__);
 
@@ -111,6 +118,7 @@ namespace Paintbox {
 	enum class ShaderType {
 		VERTEX,
 		PIXEL,
+		COMPUTE,
 		// In the future, there will be more supported shader types.
 		
 		COUNT
@@ -125,9 +133,22 @@ namespace Paintbox {
 		
 		ALPHA_F32,
 		
+		// Block compressed formats. Each 4x4 block of texels is stored in 8 (BC1) or 16 (BC5) bytes.
+		// They can only be filled with texture_upload_mip.
+		BC1_RGB, // Color, without alpha.
+		BC5_RG,  // Two independent channels. Good for normal maps: store x and y, rebuild z in the shader.
+		
+		// These come after the block formats, so the values stored in texture files don't change.
+		RGB_U8,
+		RG_U8, // Half the memory of RGBA_U8 for normal maps, when they don't go through the bake tool.
+		
 		COUNT
 	};
 	
+	enum TextureConvertFlags : uint32_t {
+		TEXTURE_CONVERT_PREMULTIPLY_ALPHA = 1 << 0, // Multiplies color by alpha on the way. Only for RGBA_U8 and RGBA_F16 destinations.
+	};
+	
 	enum class VertexFormat {
 		XYZ_RGBA_UV,
 		// In the future, we may support other vertex formats, but for now, this is the default one.
@@ -154,17 +175,154 @@ namespace Paintbox {
 		TextureFormat format {};
 		int32_t width = 0;
 		int32_t height = 0;
+		int32_t mip_count = 1;
 	};
 	
 	struct Canvas : Resource {
 		TextureFormat format {};
 		int32_t width = 0;
 		int32_t height = 0;
+		
+		Texture* texture = nullptr; // What the canvas renders into. Sample it like any other texture.
+	};
+	
+	// Identifies a pixel read that is still on its way back from the GPU. Zero is never a valid ticket.
+	typedef uint64_t ReadbackTicket;
+	
+	struct ReadbackResult {
+		void* data = nullptr; // Tightly packed rows, bottom row first. Valid until readback_release.
+		uint32_t size = 0;
+		
+		TextureFormat format {};
+		int32_t width = 0;
+		int32_t height = 0;
+	};
+	
+	// A level of detail is a range of the mesh index buffer. Render it with mesh_render(mesh, state, lod.index_count, lod.first_index).
+	struct MeshLod {
+		uint32_t first_index = 0;
+		uint32_t index_count = 0;
+		float distance = 0; // Use this LOD once the mesh is at least this far away from the camera.
 	};
 	
+	constexpr int max_mesh_lods = 8;
+	
 	struct Mesh : Resource {
 		int32_t vertex_count = 0;
 		int32_t index_count = 0;
+		
+		// Only filled in by mesh_load, for now.
+		vec3 bounds_min;
+		vec3 bounds_max;
+		
+		int32_t lod_count = 0;
+		MeshLod lods[max_mesh_lods];
+	};
+	
+	//
+	// Mesh files
+	//
+	
+	// Layout of a mesh file (all values little endian):
+	//     MeshFileHeader
+	//     Vertex blob, starting at vertex_offset: vertex_count vertices, exactly as the GPU wants them.
+	//     Index blob, starting at index_offset: index_count uint32_t indices. LODs are ranges of it.
+	// Both blobs start at a multiple of mesh_file_alignment, so once the file is memory mapped they can be handed to the GPU without being parsed or copied.
+	constexpr uint32_t mesh_file_magic = 0x48534D50; // "PMSH"
+	constexpr uint32_t mesh_file_version = 1;
+	constexpr uint32_t mesh_file_alignment = 4096;
+	
+	struct MeshFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t header_size; // sizeof(MeshFileHeader), so readers can catch files written with a different layout.
+		
+		uint32_t vertex_format; // A VertexFormat.
+		uint32_t vertex_size;
+		uint32_t vertex_count;
+		uint32_t index_count;
+		uint32_t lod_count;
+		
+		vec3 bounds_min;
+		vec3 bounds_max;
+		
+		uint64_t vertex_offset;
+		uint64_t vertex_blob_size;
+		uint64_t index_offset;
+		uint64_t index_blob_size;
+		
+		MeshLod lods[max_mesh_lods];
+	};
+	
+	static_assert(sizeof(MeshFileHeader) == 184, "The mesh file header layout changed! Bump mesh_file_version.");
+	
+	//
+	// Texture files
+	//
+	
+	// Layout of a texture file (all values little endian):
+	//     TextureFileHeader
+	//     Mip levels, smallest first, each one starting at a multiple of texture_file_alignment.
+	// Levels are stored exactly as texture_upload_mip wants them: bottom row first, tightly packed (or in 4x4 blocks for the BC formats).
+	// Use tools/bake_texture.cpp to make them out of regular images.
+	constexpr uint32_t texture_file_magic = 0x58455450; // "PTEX"
+	constexpr uint32_t texture_file_version = 1;
+	constexpr uint32_t texture_file_alignment = 64;
+	constexpr int max_texture_mips = 16;
+	
+	struct TextureFileMip {
+		uint64_t offset;
+		uint64_t size;
+	};
+	
+	struct TextureFileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t header_size; // sizeof(TextureFileHeader)
+		
+		uint32_t format; // A TextureFormat.
+		int32_t width;
+		int32_t height;
+		uint32_t mip_count;
+		uint32_t flags; // Unused for now, always 0.
+		
+		TextureFileMip mips[max_texture_mips]; // mips[0] is the full size level.
+	};
+	
+	static_assert(sizeof(TextureFileHeader) == 288, "The texture file header layout changed! Bump texture_file_version.");
+	
+	// Uploads the levels of a texture file a few at a time, smallest first, so the texture can be used at low resolution while the rest arrives.
+	struct TextureStream {
+		Texture* texture = nullptr;
+		int32_t levels_left = 0;
+	};
+	
+	// A read-only view of a whole file. The pages are loaded by the OS as they are touched.
+	struct MappedFile {
+		void* data = nullptr;
+		uint64_t size = 0;
+	};
+	
+	// Raw GPU memory. Shaders see it as a shader storage buffer, and meshes can use it as their vertex or index data.
+	struct Buffer : Resource {
+		uint32_t size = 0;
+	};
+	
+	// How many buffers can be bound at once. buffers[i] is bound to 'layout (binding = i)' in the shaders.
+	constexpr int max_bound_buffers = 4;
+	
+	// Shaders see RenderState::constants as 'uniform vec4 constants[4]'.
+	constexpr int max_shader_constants = 4;
+	
+	// Use these with memory_barrier() to say how data written by a compute shader is going to be read next.
+	enum BarrierBits : uint32_t {
+		BARRIER_VERTEX_BUFFER  = 1 << 0, // Vertices fetched by mesh_render.
+		BARRIER_INDEX_BUFFER   = 1 << 1, // Indices fetched by mesh_render.
+		BARRIER_STORAGE_BUFFER = 1 << 2, // Storage buffer reads and writes in any shader.
+		BARRIER_TEXTURE_FETCH  = 1 << 3, // Texture sampling in any shader.
+		BARRIER_BUFFER_UPDATE  = 1 << 4, // buffer_upload and mesh_upload.
+		
+		BARRIER_ALL = 0xFFFFFFFF,
 	};
 	
 	union Vertex { // In the future, this will probably be renamed since we will have more vertex formats.
@@ -194,6 +352,110 @@ namespace Paintbox {
 	
 	static_assert(sizeof(Vertex) == 9 * sizeof(float), "Wrong vertex size!");
 	
+	// A CPU-side list of triangles that is filled by the path functions (and anything else that generates geometry) and later uploaded to a Mesh in one go.
+	// The arrays grow as needed and are owned by the batch.
+	struct Batch {
+		Vertex* vertices = nullptr;
+		uint32_t* indices = nullptr;
+		
+		uint32_t vertex_count = 0;
+		uint32_t index_count = 0;
+		
+		uint32_t vertex_capacity = 0;
+		uint32_t index_capacity = 0;
+	};
+	
+	//
+	// Vector paths
+	//
+	
+	enum class PathVerb : uint8_t {
+		MOVE,
+		LINE,
+		QUAD,
+		CUBIC,
+		CLOSE,
+		
+		COUNT
+	};
+	
+	enum class FillRule {
+		NON_ZERO,
+		EVEN_ODD,
+		
+		COUNT
+	};
+	
+	enum class LineJoin {
+		MITER,
+		ROUND,
+		BEVEL,
+		
+		COUNT
+	};
+	
+	enum class LineCap {
+		BUTT,
+		ROUND,
+		SQUARE,
+		
+		COUNT
+	};
+	
+	// Paths are lists of verbs and the points they consume (MOVE and LINE take one point, QUAD takes two, CUBIC takes three and CLOSE takes none).
+	// Arcs are converted to cubics when they are added, so they don't need a verb of their own.
+	// The arrays grow as needed and are owned by the path. Use the path_* functions below to build one.
+	struct Path {
+		PathVerb* verbs = nullptr;
+		vec2* points = nullptr;
+		
+		int32_t verb_count = 0;
+		int32_t point_count = 0;
+		
+		int32_t verb_capacity = 0;
+		int32_t point_capacity = 0;
+		
+		int32_t contour_start = 0; // Index of the point of the last MOVE, where a segment after a CLOSE starts its new contour.
+	};
+	
+	struct PathStyle {
+		vec4 color = {1, 1, 1, 1};
+		float z = 0; // Written to the z component of every generated vertex.
+		
+		// Fill parameters
+		FillRule fill_rule = FillRule::NON_ZERO;
+		
+		// Stroke parameters
+		float stroke_width = 1;
+		LineJoin line_join = LineJoin::MITER;
+		LineCap line_cap = LineCap::BUTT;
+		float miter_limit = 4;
+		
+		// Width, in pixels, of the fringe that fades the shape edges to transparent. Set it to 0 to disable antialiasing.
+		// The fringe relies on alpha blending, so render the result with BlendMode::ALPHA, or as a transparent layer of a DrawList.
+		float feather = 1;
+		
+		// Maximum distance, in pixels, between a curve and the line segments used to approximate it.
+		float tolerance = 0.25f;
+	};
+	
+	enum class BlendMode {
+		NONE,                // The result replaces what was there. What opaque draws want.
+		ALPHA,               // result = source * source_alpha + destination * (1 - source_alpha)
+		PREMULTIPLIED_ALPHA, // result = source + destination * (1 - source_alpha)
+		ADDITIVE,            // result = source * source_alpha + destination
+		
+		COUNT
+	};
+	
+	// How a draw list treats a draw. See DrawList.
+	enum class LayerMode {
+		OPAQUE,
+		TRANSPARENT,
+		
+		COUNT
+	};
+	
 	struct RenderState {
 		Shader* vertex_shader = nullptr; // Null means the default (identity) vertex shader.
 		Shader* pixel_shader = nullptr; // Null means the default pixel shader.
@@ -201,8 +463,20 @@ namespace Paintbox {
 		
 		Texture* texture0 = nullptr;
 		Texture* texture1 = nullptr;
+		Texture* texture2 = nullptr; // Like the other two, vertex shaders can read it too.
+		
+		Buffer* buffers[max_bound_buffers] = {};
+		
+		uint32_t instance_count = 1; // The mesh is drawn this many times, with gl_InstanceID going from 0 to instance_count - 1.
 		
 		Rect viewport = {0, 0, 0, 0};
+		Rect scissor = {0, 0, 0, 0}; // Pixels outside of it are left alone. Zero size means no scissor.
+		
+		BlendMode blend_mode = BlendMode::NONE;
+		
+		// Depth is the z of the vertices after the projection, and smaller is closer. Canvases and the backbuffer both have a depth buffer, cleared by canvas_clear.
+		bool depth_test = false;  // Skip fragments that are behind what's already there.
+		bool depth_write = false; // Store the depth of the fragments that are drawn.
 		
 		// Shader constants
 		mat4 projection = {
@@ -211,6 +485,189 @@ namespace Paintbox {
 			0, 0, 1, 0,
 			0, 0, 0, 1,
 		};
+		vec4 constants[max_shader_constants] = {}; // Whatever the shaders want them to mean.
+	};
+	
+	struct DrawCommand {
+		Mesh* mesh = nullptr;
+		RenderState state;
+		int32_t index_count = -1;
+		uint32_t first_index = 0;
+		
+		LayerMode mode = LayerMode::OPAQUE;
+		float depth = 0;
+		uint32_t sequence = 0; // Submission order, so draws at the same depth keep it.
+		
+		// Canvas pixels the draw can touch, only used by damage_render. Zero size means anything inside the scissor, or the viewport if there is no scissor.
+		Rect bounds = {0, 0, 0, 0};
+	};
+	
+	// Collects the draws of a frame and submits them in the order that wastes the least fill rate:
+	// - Opaque draws first, front to back, with depth test and depth write on and blending off. Whatever ends up behind them is rejected by the depth test before the pixel shader runs.
+	// - Transparent draws last, back to front, with depth test on (so opaque draws still hide them) but depth write off.
+	// 'depth' is only used to sort the draws. Give each draw the z of its layer, in the same space as RenderState::depth_test.
+	// The array grows as needed and is owned by the draw list.
+	struct DrawList {
+		DrawCommand* commands = nullptr;
+		uint32_t count = 0;
+		uint32_t capacity = 0;
+	};
+	
+	//
+	// Damage tracking
+	//
+	
+	constexpr int32_t max_damage_rects = 8;
+	
+	// Redraws only the parts of a frame that changed since the last one. The frame lives in a canvas that is kept around: mark what changed with damage_add,
+	// and damage_render clears just those rects and redraws the draws that touch them, scissored to them. Everything else is left as it was.
+	// Rects are in canvas pixels, with the origin at the bottom left, like the viewport.
+	struct DamageTracker {
+		Canvas* canvas = nullptr;
+		
+		// What the last damage_render redrew. The rects never overlap, so they can be handed to a partial present (like EGL_KHR_swap_buffers_with_damage) as they are.
+		Rect rects[max_damage_rects];
+		int32_t rect_count = 0;
+	};
+	
+	//
+	// Lights
+	//
+	
+	// A point light for normal-mapped 2D surfaces. The position is in canvas pixels, with the origin at the bottom left like gl_FragCoord, and z is the height above the surface.
+	// The light fades out smoothly and is gone 'radius' pixels away, measured along the surface.
+	struct PointLight {
+		vec3 position;
+		float radius;
+		vec3 color;
+		float intensity;
+	};
+	
+	constexpr int32_t light_tile_size = 16; // In pixels.
+	constexpr int32_t max_lights_per_tile = 64;
+	
+	// Where light_grid_bind puts the buffers. light_grid_glsl() hard-codes them.
+	constexpr int light_buffer_binding = 2;
+	constexpr int light_tile_buffer_binding = 3;
+	
+	// Splits a canvas into tiles and keeps the list of lights that reach each of them, so a pixel only loops over the lights that can actually light it.
+	// The lists are built on the CPU and uploaded to storage buffers, where pixel shaders read them through light_grid_glsl().
+	struct LightGrid {
+		int32_t width = 0;
+		int32_t height = 0;
+		int32_t tiles_x = 0;
+		int32_t tiles_y = 0;
+		int32_t max_lights = 0;
+		
+		Buffer* light_buffer = nullptr; // The PointLights, as they were given to light_grid_update.
+		Buffer* tile_buffer = nullptr;  // A header, then an (offset, count) pair per tile, then the light indices of every tile.
+		
+		// What the last light_grid_update did. Useful for profiling.
+		int32_t light_count = 0;
+		uint32_t index_count = 0; // Lights summed over every tile.
+		int32_t dropped_count = 0; // Lights left out of tiles that already had max_lights_per_tile.
+	};
+	
+	//
+	// Vertex animation
+	//
+	
+	// Baked frames are stored one after the other, each with the positions of every vertex in order, and wrap into rows of this many texels.
+	constexpr int32_t vertex_animation_texture_width = 4096;
+	
+	// Where vertex_animation_bind puts the instance buffer.
+	constexpr int vertex_animation_instance_binding = 0;
+	
+	// One copy of an animated mesh. Instances play the same animation, each at its own time and place.
+	struct VertexAnimationInstance {
+		vec2 offset;       // Added to the baked positions, before the projection.
+		float time_offset; // In seconds.
+		float speed;       // 1 plays at the baked rate, 0 freezes the instance.
+	};
+	
+	// The positions of every vertex of a mesh, for every frame of an animation, in a texture the GPU plays back from. Animating a mesh then costs a few uniforms
+	// per draw instead of a mesh_upload, and one draw can play many instances of it.
+	struct VertexAnimation {
+		Texture* texture = nullptr; // RGBA_F16 keeps a position per texel, ALPHA_F32 one coordinate per texel.
+		int32_t vertex_count = 0;
+		int32_t frame_count = 0;
+		float frames_per_second = 0;
+	};
+	
+	//
+	// Cloth
+	//
+	
+	// A rectangular sheet of particles held together by distance constraints, simulated with position based dynamics. It starts flat, in the xy plane,
+	// going right and down from its top left particle. Each step writes the particles straight into the vertices of 'mesh', ready to render.
+	struct Cloth {
+		int32_t columns = 0;
+		int32_t rows = 0;
+		Mesh* mesh = nullptr; // A vertex per particle, row by row from the top, with uvs going from 0 to 1 across the sheet.
+		
+		// Read by every step, so they can be changed at any time.
+		vec3 acceleration = vec3(0, -9.8f, 0); // Gravity, plus whatever wind you want.
+		float damping = 0.1f;                  // Fraction of the velocity lost every second.
+		int32_t substeps = 8;                  // Each step is split into this many. More make the cloth stiffer, and do it better than more iterations at the same cost.
+		int32_t iterations = 1;                // Constraint passes per substep.
+		float stretch_stiffness = 1;           // From 0 to 1, for the constraints between neighbors and diagonal neighbors.
+		float bend_stiffness = 0.2f;           // From 0 to 1, for the constraints that skip a particle.
+		
+		// Constraints come in batches that share no particles, so each batch can be solved by many threads at once. Useful for profiling.
+		int32_t batch_count = 0;
+	};
+	
+	//
+	// Falling sand
+	//
+	
+	enum class CellType : uint8_t {
+		EMPTY,
+		SAND,
+		WATER,
+		STONE,
+		
+		COUNT
+	};
+	
+	// The world is split into square chunks. Each chunk only simulates the rectangle of cells that changed around it last step, and chunks with nothing going on are skipped entirely.
+	constexpr int32_t sand_chunk_size = 64;
+	
+	struct SandWorld {
+		int32_t width = 0;
+		int32_t height = 0;
+		uint64_t step_count = 0;
+		
+		Texture* texture = nullptr; // RGBA_U8, one texel per cell. Kept up to date by sand_upload.
+		
+		int32_t awake_chunk_count = 0; // How many chunks the last sand_step had to look at. Useful for profiling.
+	};
+	
+	//
+	// Capture and replay
+	//
+	
+	// Filled in by replay_frame for every frame it plays back.
+	struct ReplayFrameStats {
+		int32_t frame_index = 0;
+		uint32_t call_count = 0;
+		
+		double recorded_seconds = 0; // How long the frame took when it was captured, from the end of the previous frame to the end of this one.
+		double cpu_seconds = 0;      // How long it took to issue this frame's calls during the replay. Call gpu_finish() after replay_frame to measure the GPU side too.
+	};
+	
+	struct Replay {
+		int32_t frame_count = 0;
+		int32_t next_frame = 0;
+	};
+	
+	struct ComputeState {
+		Shader* compute_shader = nullptr;
+		
+		Texture* texture0 = nullptr;
+		Texture* texture1 = nullptr;
+		
+		Buffer* buffers[max_bound_buffers] = {};
 	};
 	
 	//
@@ -223,17 +680,222 @@ namespace Paintbox {
 	// #todo: shader_hotload
 	// #todo: shader_destroy
 	
+	// Canvas
+	Canvas* canvas_create(TextureFormat format, int32_t width, int32_t height); // Comes with a depth buffer.
+	void canvas_clear(Canvas* canvas, vec4 color, float depth = 1, Rect rect = {}); // Null canvas means the backbuffer. A depth of 1 is as far as it gets. Zero size rect means the whole canvas.
+	void canvas_blit(Canvas* source, Canvas* destination, Rect rect); // Copies the pixels in rect to the same place in the destination. Null destination means the backbuffer.
+	// #todo: canvas_destroy
+	
+	// Readback
+	// Reads go through a small pool of pixel buffers and fences, so the GPU keeps going while the pixels travel back. Poll the ticket a frame or two later.
+	// 'format' is what the GPU writes into the buffer. With convert_to_rgba_u8, a worker thread turns it into RGBA_U8 before the ticket becomes ready.
+	ReadbackTicket canvas_read_async(Canvas* canvas, Rect rect, TextureFormat format, bool convert_to_rgba_u8 = false); // Null canvas means the backbuffer. Returns 0 if every slot in the pool is busy.
+	bool readback_poll(ReadbackTicket ticket, ReadbackResult* result); // Returns true and fills in the result once the pixels have arrived.
+	void readback_release(ReadbackTicket ticket); // Gives the slot back to the pool. Call it once you are done with the result, or to cancel a read.
+	
 	// Texture 
-	Texture* texture_create(TextureFormat format, int32_t width, int32_t height, void* image_data);
+	// If source_format is given, image_data is in that format and gets converted to 'format' first. See texture_convert.
+	Texture* texture_create(TextureFormat format, int32_t width, int32_t height, void* image_data, TextureFormat source_format = TextureFormat::NONE, uint32_t convert_flags = 0);
+	
+	// Converts 8 bit images, the way image loaders hand them out, to the formats the GPU wants. Sources can be RGBA_U8 or RGB_U8 (which gets an alpha of 255).
+	// Destinations:
+	//     RGBA_U8
+	//     RGBA_S8   0..255 maps to -1..1, for normal maps.
+	//     RGBA_F16
+	//     ALPHA_F32 The alpha channel, or red for RGB_U8 sources.
+	//     RG_U8     Red and green, like the x and y of a normal map.
+	// Rows are tightly packed. Uses SSE2 where available, and the job threads for big images.
+	void texture_convert(TextureFormat destination_format, void* destination, TextureFormat source_format, void* source, int32_t width, int32_t height, uint32_t flags = 0);
+	
+	// Replaces a rectangle of texels. 'data_row_length' is the width of the source image in pixels, so you can upload a piece of a bigger image without copying it out first. Leave it as 0 if the data is tightly packed.
+	void texture_update(Texture* texture, int32_t x, int32_t y, int32_t width, int32_t height, void* data, int32_t data_row_length = 0);
+	
+	// Creates a texture with room for mip_count levels but no contents yet. Fill the levels in with texture_upload_mip, smallest first:
+	// sampling is limited to the levels that have been uploaded so far.
+	Texture* texture_allocate(TextureFormat format, int32_t width, int32_t height, int32_t mip_count);
+	void texture_upload_mip(Texture* texture, int32_t level, void* data, uint32_t size);
+	uint32_t texture_level_size(TextureFormat format, int32_t width, int32_t height); // Bytes needed by one level of this size.
+	
+	// Texture files
+	Texture* texture_load(const char* path); // Maps the file and uploads every level. Returns null if the file is missing or malformed.
+	TextureStream* texture_stream_open(const char* path); // Returns null if the file is missing or malformed. The smallest level is uploaded right away.
+	bool texture_stream_update(TextureStream* stream, uint64_t byte_budget); // Uploads levels until the budget runs out. Returns true, and frees the stream, once every level is in.
 	// #todo: texture_destroy
 	
 	// Mesh
 	Mesh* mesh_create(uint32_t vertex_count, uint32_t index_count, Vertex vertices[] = nullptr, uint32_t indices[] = nullptr); // If you leave vertices and indices null, this function will just allocate VRAM for the geometry. If that's the case, you must upload mesh data using mesh_upload.
+	Mesh* mesh_create_u16(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint16_t indices[]); // Half the index memory, for meshes with at most 65536 vertices. mesh_upload can't be used on these.
 	
 	void mesh_upload(Mesh* mesh, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[]);
-	void mesh_render(Mesh* mesh, RenderState* state, int32_t index_count = -1); // Leave index count as -1 to render all the indices.
+	
+	// Gives direct access to the vertex memory of a mesh, so it can be filled without a copy, by any thread. The previous contents are lost, so write every vertex.
+	// Call both from the rendering thread, and don't render the mesh until it's unmapped.
+	Vertex* mesh_map_vertices(Mesh* mesh);
+	void mesh_unmap_vertices(Mesh* mesh);
+	
+	void mesh_render(Mesh* mesh, RenderState* state, int32_t index_count = -1, uint32_t first_index = 0); // Leave index count as -1 to render all the indices.
+	
+	// Mesh files
+	// mesh_load maps the file and hands the vertex and index blobs straight to the GPU. Returns null if the file is missing or malformed.
+	// mesh_save computes the bounds for you. Pass LODs sorted by distance; with no LODs, the whole index buffer is the only one.
+	Mesh* mesh_load(const char* path);
+	bool mesh_save(const char* path, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[], MeshLod lods[] = nullptr, int32_t lod_count = 0);
+	int32_t mesh_select_lod(Mesh* mesh, float distance); // Index into mesh->lods of the LOD to use at this distance from the camera.
+	
+	// Mesh optimization
+	// mesh_optimize works in place, and returns the new vertex count. It welds vertices that are identical, orders the triangles for the post-transform vertex cache,
+	// then moves the outward facing parts of the mesh to the front to cut overdraw, and finally orders the vertices in the order the triangles use them. Unused vertices are dropped.
+	// It takes a while on big meshes, so do it when importing, before mesh_save, rather than every time the mesh is loaded.
+	// Triangles are treated as counter-clockwise, which only matters for the overdraw order.
+	uint32_t mesh_optimize(Vertex vertices[], uint32_t vertex_count, uint32_t indices[], uint32_t index_count);
+	Mesh* mesh_create_optimized(uint32_t vertex_count, uint32_t index_count, Vertex vertices[], uint32_t indices[]); // Optimizes a copy, and uses 16 bit indices when the vertices fit.
+	
+	// Use buffers written by compute shaders as mesh geometry, without the data ever going through the CPU. The index buffer holds uint32_t indices.
+	// Remember to call memory_barrier(BARRIER_VERTEX_BUFFER | BARRIER_INDEX_BUFFER) between the dispatch that writes the buffers and the render.
+	Mesh* mesh_create_from_buffers(Buffer* vertex_buffer, Buffer* index_buffer, uint32_t vertex_count, uint32_t index_count);
+	
+	// Buffer
+	Buffer* buffer_create(uint32_t size, void* data = nullptr); // Leave data null to allocate uninitialized memory.
+	void buffer_upload(Buffer* buffer, uint32_t offset, uint32_t size, void* data);
+	void buffer_destroy(Buffer* buffer); // Don't use the buffer afterwards, and don't destroy one that a mesh borrows through mesh_create_from_buffers.
+	
+	// Compute
+	void compute_dispatch(ComputeState* state, uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+	void memory_barrier(uint32_t barrier_bits); // See BarrierBits.
+	
+	// Files
+	bool file_map(const char* path, MappedFile* file); // Returns false if the file can't be opened. Empty files can't be mapped either.
+	void file_unmap(MappedFile* file);
+	
+	// Capture
+	// Records every resource creation, upload and draw, with all the data they reference, into a trace file that can be played back without the application.
+	// Start the capture before creating any resources, since the trace can't refer to resources it hasn't seen being made.
+	// #incomplete: Compute dispatches, memory barriers, mesh_create_from_buffers and readbacks are not captured yet.
+	bool capture_begin(const char* path); // Returns false if the file can't be created.
+	void capture_frame_end(); // Call once per frame, after the last draw.
+	void capture_end();
+	bool capture_is_active();
+	
+	// Replay
+	// Needs an initialized Paintbox, like any other user of the API. Draws go wherever they went during the capture, which usually means the backbuffer.
+	Replay* replay_open(const char* path); // Returns null if the file is missing or isn't a trace.
+	bool replay_frame(Replay* replay, ReplayFrameStats* stats); // Plays the next frame back as fast as possible. Returns false once the trace is over.
+	void replay_close(Replay* replay); // #memory_cleanup: The resources the replay created stay alive.
+	
+	// Time
+	// The 'time' shader uniform normally comes from the system clock. Overriding it makes rendering deterministic, which replays rely on.
+	double shader_time();
+	void time_override(double seconds);
+	void time_override_clear();
+	
+	void gpu_finish(); // Blocks until the GPU has finished every command issued so far. Only useful for measurements.
+	void gpu_state_invalidate(); // mesh_render skips state that is already bound. If you make graphics API calls of your own (an imgui backend, say), call this afterwards so the next draw sets everything again.
+	
+	// Jobs
+	// A pool of worker threads, started on first use. The calling thread does its share of the work, and parallel_for only returns once every index is done.
+	// Calling parallel_for from inside a job just runs the loop serially.
+	void parallel_for(int32_t count, void (*proc)(int32_t index, void* user_data), void* user_data);
+	int32_t job_thread_count(); // Worker threads plus the calling thread.
+	void job_run_async(void (*proc)(void* user_data), void* user_data); // Runs proc on a worker thread some time later. Use your own flag to find out when it's done.
+	
+	// Falling sand
+	SandWorld* sand_world_create(int32_t width, int32_t height); // Width and height must be multiples of sand_chunk_size.
+	
+	void sand_set_cell(SandWorld* world, int32_t x, int32_t y, CellType type);
+	CellType sand_get_cell(SandWorld* world, int32_t x, int32_t y);
+	void sand_paint(SandWorld* world, vec2 center, float radius, CellType type); // Sets every cell inside the circle.
+	
+	void sand_step(SandWorld* world); // Advances the simulation by one tick, using the job threads.
+	void sand_upload(SandWorld* world); // Sends the cells that changed since the last upload to world->texture.
+	
+	// Draw lists
+	// The state is copied, so it can be changed right after the call. If a transparent draw has no blend mode, ALPHA is used.
+	// Returns the command, in case you want to fill in its bounds. It's only valid until the next draw_list_add.
+	DrawCommand* draw_list_add(DrawList* list, LayerMode mode, float depth, Mesh* mesh, RenderState* state, int32_t index_count = -1, uint32_t first_index = 0);
+	void draw_list_sort(DrawList* list); // Puts the draws in the order they are rendered in. draw_list_submit and damage_render do this for you.
+	
+	// Draw lists don't touch the GPU until they are submitted, so each thread can fill one of its own, as long as resources are created up front.
+	// Then merge them on the rendering thread and submit the result: draws that tie in the sort keep the order of the merges.
+	void draw_list_merge(DrawList* list, DrawList* source); // Moves the draws of source to the end of list, and empties source.
+	void draw_list_submit(DrawList* list); // Sorts and renders every draw, then empties the list but keeps the memory around.
+	void draw_list_free(DrawList* list);
+	
+	// Damage tracking
+	DamageTracker* damage_tracker_create(TextureFormat format, int32_t width, int32_t height); // The whole canvas counts as damaged until the first damage_render.
+	void damage_add(DamageTracker* tracker, Rect rect); // Rects that overlap are merged, and once there are too many, the closest ones are.
+	void damage_add_all(DamageTracker* tracker);
+	
+	// Clears the damaged rects of tracker->canvas and renders the draws of the list that touch them into it, whatever canvas their state has. Then the damage and the list are emptied.
+	// Build the whole list every frame as usual: only the draws that are needed get to the GPU. Returns false if nothing was damaged, so there is nothing new to present.
+	bool damage_render(DamageTracker* tracker, DrawList* list, vec4 clear_color);
+	
+	// Copies the canvas to the destination, or to the backbuffer if that's null. With damaged_only, just the rects of the last damage_render are copied:
+	// that's only right if the destination still holds the previous frame, like a canvas or a backbuffer that is preserved across swaps.
+	void damage_present(DamageTracker* tracker, Canvas* destination, bool damaged_only = false);
+	
+	// Cloth
+	Cloth* cloth_create(int32_t columns, int32_t rows, vec3 top_left, float spacing, vec4 color);
+	void cloth_pin(Cloth* cloth, int32_t column, int32_t row, bool pinned = true); // Pinned particles only move when cloth_set_position moves them.
+	void cloth_set_position(Cloth* cloth, int32_t column, int32_t row, vec3 position);
+	vec3 cloth_get_position(Cloth* cloth, int32_t column, int32_t row);
+	
+	// Advances every cloth by 'seconds', one cloth per job thread, and writes the results into the mapped vertices of their meshes.
+	// A single cloth spreads its constraint batches over the job threads instead.
+	void cloth_step(Cloth* cloths[], int32_t cloth_count, float seconds);
+	
+	// Vertex animation
+	// 'positions' holds frame_count frames of vertex_count positions. Halves lose precision quickly away from zero, so keep the positions in the space of the mesh when using RGBA_F16.
+	VertexAnimation* vertex_animation_create(TextureFormat format, int32_t vertex_count, int32_t frame_count, vec3 positions[], float frames_per_second);
+	
+	// Makes the draws of 'state' play the animation, in a loop, blending between frames: sets the built-in vertex shader, texture2, the constants and the instance buffer.
+	// The mesh that is drawn gives the colors and uvs, and needs the same vertices in the same order as the baked frames.
+	// 'instances' holds instance_count VertexAnimationInstances. Leave it null for a single instance at the origin, playing in step with shader_time().
+	void vertex_animation_bind(VertexAnimation* animation, RenderState* state, Buffer* instances = nullptr, uint32_t instance_count = 1);
+	
+	// Lights
+	LightGrid* light_grid_create(int32_t width, int32_t height, int32_t max_lights); // The size of the canvas the lit draws go to.
+	
+	// Bins the lights into the tiles on the job threads and uploads the result. Call it once per frame, before the draws that use the grid.
+	// A tile with more than max_lights_per_tile lights keeps the first ones of the array, so put the important lights first.
+	void light_grid_update(LightGrid* grid, PointLight lights[], int32_t light_count);
+	void light_grid_bind(LightGrid* grid, RenderState* state); // Sets the buffers at light_buffer_binding and light_tile_buffer_binding.
+	void light_grid_destroy(LightGrid* grid); // Frees the buffers too. To follow the size of a window, destroy the grid and create another one.
+	
+	// GLSL for pixel shaders lit by a light grid, to put between the #version line (430 or later, for the storage buffers) and the rest of the shader.
+	// It declares 'vec3 light_grid_light(vec3 normal)', which adds up the light reaching the pixel for a normal with z pointing towards the viewer.
+	const char* light_grid_glsl();
+	
+	// Batch
+	void batch_clear(Batch* batch); // Resets the counts but keeps the memory around for the next frame.
+	void batch_free(Batch* batch);
+	void batch_reserve(Batch* batch, uint32_t vertex_count, uint32_t index_count); // Makes sure the batch can take this many more vertices and indices without growing.
+	void batch_upload(Batch* batch, Mesh* mesh); // The mesh must have been created with enough room for the whole batch.
+	
+	// Paths
+	void path_clear(Path* path); // Removes all the verbs but keeps the memory around.
+	void path_free(Path* path);
+	
+	// With no current point, the *_to functions just start a contour at their end point. After a close, they start a new one where the closed contour started.
+	void path_move_to(Path* path, vec2 point);
+	void path_line_to(Path* path, vec2 point);
+	void path_quad_to(Path* path, vec2 control, vec2 point);
+	void path_cubic_to(Path* path, vec2 control0, vec2 control1, vec2 point);
+	void path_arc(Path* path, vec2 center, float radius, float start_angle, float end_angle); // Angles are in radians, counter-clockwise. Connects to the current point with a line, if there is one.
+	void path_close(Path* path);
+	
+	void path_rect(Path* path, Rect rect);
+	void path_circle(Path* path, vec2 center, float radius);
+	
+	// Tessellate the path and append the triangles to the batch.
+	// 'scale' is how many pixels one path unit covers once the path is on screen. It controls how finely curves are flattened and how wide the antialiasing fringe is.
+	// Results are cached by path contents, style and scale, so calling these every frame with static paths only costs a hash and a copy.
+	void path_fill(Path* path, PathStyle* style, float scale, Batch* batch);
+	void path_stroke(Path* path, PathStyle* style, float scale, Batch* batch);
+	
+	void path_cache_flush(); // Frees every cached tessellation.
 		
 	// Math functions 
+	uint16_t float_to_half(float value); // Rounds to the nearest half. Too big becomes infinity.
 	
 	// Operator overloads for math types
 	// #todo: These could be generated by a metaprogram, or turned into templates (?)
@@ -305,4 +967,19 @@ namespace Paintbox {
 	void mark_next_resource(const char* name, const char* file, int32_t line);
 	void register_resource(Resource* resource);
 	
+	// Called by the backend so the capture can record what happened. They do nothing unless a capture is active.
+	void capture_shader_create(Shader* shader, ShaderLanguage language, ShaderType type, const char* shader_source_code);
+	void capture_texture_create(Texture* texture, void* image_data);
+	void capture_texture_update(Texture* texture, int32_t x, int32_t y, int32_t width, int32_t height, void* data, int32_t data_row_length);
+	void capture_texture_allocate(Texture* texture);
+	void capture_texture_upload_mip(Texture* texture, int32_t level, void* data, uint32_t size);
+	void capture_canvas_create(Canvas* canvas);
+	void capture_canvas_clear(Canvas* canvas, vec4 color, float depth, Rect rect);
+	void capture_canvas_blit(Canvas* source, Canvas* destination, Rect rect);
+	void capture_mesh_create(Mesh* mesh, Vertex vertices[], void* indices, uint32_t index_size);
+	void capture_mesh_upload(Mesh* mesh, uint32_t vertex_count, Vertex vertices[], uint32_t index_count, uint32_t indices[]);
+	void capture_mesh_render(Mesh* mesh, RenderState* state, int32_t index_count, uint32_t first_index, double time);
+	void capture_buffer_create(Buffer* buffer, void* data);
+	void capture_buffer_upload(Buffer* buffer, uint32_t offset, uint32_t size, void* data);
+	
 }
\ No newline at end of file
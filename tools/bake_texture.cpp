@@ -0,0 +1,322 @@
+// Turns a regular image (anything stb_image reads) into a Paintbox texture file: flipped, mip-chained and optionally block compressed, ready to be mapped and uploaded as is.
+//
+// Usage: bake_texture <input image> <output file> [rgba8 | bc1 | bc5] [--normal]
+//     rgba8    Uncompressed. The default.
+//     bc1      Color without alpha, 4 bits per texel.
+//     bc5      Red and green only, 8 bits per texel. Use it for normal maps and rebuild z in the shader.
+//     --normal The image is a tangent space normal map. Mips are renormalized after filtering.
+//
+// This tool only uses the file format declarations from paintbox.h, so it builds without the rest of the library.
+
+#include "paintbox.h"
+using namespace Paintbox;
+
+#include <string.h>
+#include <math.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct Image {
+	int32_t width = 0;
+	int32_t height = 0;
+	uint8_t* pixels = nullptr; // RGBA, bottom row first.
+};
+
+static uint8_t* image_texel(Image* image, int32_t x, int32_t y) {
+	// Clamping lets the block compressors read past the edges of images that aren't a multiple of 4.
+	if (x >= image->width)  x = image->width - 1;
+	if (y >= image->height) y = image->height - 1;
+	return &image->pixels[(y * image->width + x) * 4];
+}
+
+static Image downsample(Image* source, bool normal_map) {
+	Image result;
+	result.width = source->width > 1 ? source->width / 2 : 1;
+	result.height = source->height > 1 ? source->height / 2 : 1;
+	result.pixels = (uint8_t*) malloc(result.width * result.height * 4);
+	
+	for (int32_t y = 0; y < result.height; y += 1) {
+		for (int32_t x = 0; x < result.width; x += 1) {
+			// Box filter over the 2x2 footprint. Odd sizes just drop the last row or column.
+			float sum[4] = {};
+			for (int32_t dy = 0; dy < 2; dy += 1) {
+				for (int32_t dx = 0; dx < 2; dx += 1) {
+					uint8_t* texel = image_texel(source, x * 2 + dx, y * 2 + dy);
+					for (int c = 0; c < 4; c += 1) sum[c] += texel[c];
+				}
+			}
+			
+			float value[4];
+			for (int c = 0; c < 4; c += 1) value[c] = sum[c] / (4 * 255.0f);
+			
+			if (normal_map) {
+				float nx = value[0] * 2 - 1;
+				float ny = value[1] * 2 - 1;
+				float nz = value[2] * 2 - 1;
+				float length = sqrtf(nx * nx + ny * ny + nz * nz);
+				if (length > 0) {
+					value[0] = nx / length * 0.5f + 0.5f;
+					value[1] = ny / length * 0.5f + 0.5f;
+					value[2] = nz / length * 0.5f + 0.5f;
+				}
+			}
+			
+			uint8_t* out = &result.pixels[(y * result.width + x) * 4];
+			for (int c = 0; c < 4; c += 1) out[c] = (uint8_t) (value[c] * 255 + 0.5f);
+		}
+	}
+	
+	return result;
+}
+
+//
+// BC1
+//
+
+static uint16_t pack_565(float r, float g, float b) {
+	auto quantize = [](float value, int max) {
+		int result = (int) (value / 255 * max + 0.5f);
+		return result < 0 ? 0 : (result > max ? max : result);
+	};
+	return (uint16_t) ((quantize(r, 31) << 11) | (quantize(g, 63) << 5) | quantize(b, 31));
+}
+
+static void unpack_565(uint16_t color, float* out) {
+	out[0] = ((color >> 11) & 31) * 255 / 31.0f;
+	out[1] = ((color >> 5) & 63) * 255 / 63.0f;
+	out[2] = (color & 31) * 255 / 31.0f;
+}
+
+static void compress_bc1_block(Image* image, int32_t block_x, int32_t block_y, uint8_t* out) {
+	float texels[16][3];
+	float mean[3] = {};
+	for (int i = 0; i < 16; i += 1) {
+		uint8_t* texel = image_texel(image, block_x * 4 + i % 4, block_y * 4 + i / 4);
+		for (int c = 0; c < 3; c += 1) {
+			texels[i][c] = texel[c];
+			mean[c] += texel[c] / 16.0f;
+		}
+	}
+	
+	// Fit the endpoints along the principal axis of the block colors, found with a few power iterations on the covariance matrix.
+	float covariance[3][3] = {};
+	for (int i = 0; i < 16; i += 1) {
+		for (int a = 0; a < 3; a += 1) {
+			for (int b = 0; b < 3; b += 1) covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+		}
+	}
+	
+	float axis[3] = {1, 1, 1};
+	for (int iteration = 0; iteration < 8; iteration += 1) {
+		float next[3] = {};
+		for (int a = 0; a < 3; a += 1) {
+			for (int b = 0; b < 3; b += 1) next[a] += covariance[a][b] * axis[b];
+		}
+		
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) break; // Flat block, any axis will do.
+		for (int a = 0; a < 3; a += 1) axis[a] = next[a] / length;
+	}
+	
+	float min_t = 0, max_t = 0;
+	for (int i = 0; i < 16; i += 1) {
+		float t = 0;
+		for (int c = 0; c < 3; c += 1) t += (texels[i][c] - mean[c]) * axis[c];
+		if (t < min_t) min_t = t;
+		if (t > max_t) max_t = t;
+	}
+	
+	uint16_t color0 = pack_565(mean[0] + axis[0] * max_t, mean[1] + axis[1] * max_t, mean[2] + axis[2] * max_t);
+	uint16_t color1 = pack_565(mean[0] + axis[0] * min_t, mean[1] + axis[1] * min_t, mean[2] + axis[2] * min_t);
+	
+	// color0 > color1 selects the four color mode. The three color mode is only for punch-through alpha, which we don't use.
+	if (color0 < color1) {
+		uint16_t swap = color0;
+		color0 = color1;
+		color1 = swap;
+	}
+	
+	uint32_t indices = 0;
+	if (color0 != color1) {
+		float palette[4][3];
+		unpack_565(color0, palette[0]);
+		unpack_565(color1, palette[1]);
+		for (int c = 0; c < 3; c += 1) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		
+		for (int i = 0; i < 16; i += 1) {
+			uint32_t best_index = 0;
+			float best_distance = 1e30f;
+			for (uint32_t p = 0; p < 4; p += 1) {
+				float distance = 0;
+				for (int c = 0; c < 3; c += 1) distance += (texels[i][c] - palette[p][c]) * (texels[i][c] - palette[p][c]);
+				if (distance < best_distance) {
+					best_distance = distance;
+					best_index = p;
+				}
+			}
+			indices |= best_index << (i * 2);
+		}
+	}
+	
+	memcpy(out + 0, &color0, 2);
+	memcpy(out + 2, &color1, 2);
+	memcpy(out + 4, &indices, 4);
+}
+
+//
+// BC5 (two BC4 blocks, one for red and one for green)
+//
+
+static void compress_bc4_block(Image* image, int32_t block_x, int32_t block_y, int channel, uint8_t* out) {
+	uint8_t values[16];
+	uint8_t max_value = 0, min_value = 255;
+	for (int i = 0; i < 16; i += 1) {
+		values[i] = image_texel(image, block_x * 4 + i % 4, block_y * 4 + i / 4)[channel];
+		if (values[i] > max_value) max_value = values[i];
+		if (values[i] < min_value) min_value = values[i];
+	}
+	
+	// red0 > red1 selects the eight value mode: both endpoints plus six values in between.
+	float palette[8];
+	palette[0] = max_value;
+	palette[1] = min_value;
+	for (int p = 2; p < 8; p += 1) palette[p] = ((8 - p) * palette[0] + (p - 1) * palette[1]) / 7;
+	
+	uint64_t indices = 0;
+	if (max_value != min_value) {
+		for (int i = 0; i < 16; i += 1) {
+			uint64_t best_index = 0;
+			float best_distance = 1e30f;
+			for (uint64_t p = 0; p < 8; p += 1) {
+				float distance = fabsf(values[i] - palette[p]);
+				if (distance < best_distance) {
+					best_distance = distance;
+					best_index = p;
+				}
+			}
+			indices |= best_index << (i * 3);
+		}
+	}
+	
+	out[0] = max_value;
+	out[1] = min_value;
+	for (int i = 0; i < 6; i += 1) out[2 + i] = (uint8_t) (indices >> (i * 8));
+}
+
+//
+// Main
+//
+
+static uint32_t level_size(TextureFormat format, Image* image) {
+	uint32_t blocks = ((image->width + 3) / 4) * ((image->height + 3) / 4);
+	switch (format) {
+	  case TextureFormat::RGBA_U8: return image->width * image->height * 4;
+	  case TextureFormat::BC1_RGB: return blocks * 8;
+	  case TextureFormat::BC5_RG:  return blocks * 16;
+	  default: paintbox_assert(false);
+	}
+	return 0;
+}
+
+static void encode_level(TextureFormat format, Image* image, uint8_t* out) {
+	if (format == TextureFormat::RGBA_U8) {
+		memcpy(out, image->pixels, image->width * image->height * 4);
+		return;
+	}
+	
+	int32_t blocks_x = (image->width + 3) / 4;
+	int32_t blocks_y = (image->height + 3) / 4;
+	
+	for (int32_t y = 0; y < blocks_y; y += 1) {
+		for (int32_t x = 0; x < blocks_x; x += 1) {
+			if (format == TextureFormat::BC1_RGB) {
+				compress_bc1_block(image, x, y, out);
+				out += 8;
+			} else {
+				compress_bc4_block(image, x, y, 0, out + 0);
+				compress_bc4_block(image, x, y, 1, out + 8);
+				out += 16;
+			}
+		}
+	}
+}
+
+int main(int argument_count, char** arguments) {
+	if (argument_count < 3) {
+		printf("Usage: bake_texture <input image> <output file> [rgba8 | bc1 | bc5] [--normal]\n");
+		return 1;
+	}
+	
+	const char* input_path = arguments[1];
+	const char* output_path = arguments[2];
+	
+	TextureFormat format = TextureFormat::RGBA_U8;
+	bool normal_map = false;
+	
+	for (int i = 3; i < argument_count; i += 1) {
+		if      (strcmp(arguments[i], "rgba8") == 0)    format = TextureFormat::RGBA_U8;
+		else if (strcmp(arguments[i], "bc1") == 0)      format = TextureFormat::BC1_RGB;
+		else if (strcmp(arguments[i], "bc5") == 0)      format = TextureFormat::BC5_RG;
+		else if (strcmp(arguments[i], "--normal") == 0) normal_map = true;
+		else {
+			printf("Unknown option '%s'.\n", arguments[i]);
+			return 1;
+		}
+	}
+	
+	// GL wants the bottom row first, so we flip once here instead of at every load.
+	stbi_set_flip_vertically_on_load(1);
+	
+	Image levels[max_texture_mips];
+	int components;
+	levels[0].pixels = stbi_load(input_path, &levels[0].width, &levels[0].height, &components, 4);
+	if (!levels[0].pixels) {
+		printf("Failed to load '%s': %s\n", input_path, stbi_failure_reason());
+		return 1;
+	}
+	
+	int32_t mip_count = 1;
+	while (mip_count < max_texture_mips && (levels[mip_count - 1].width > 1 || levels[mip_count - 1].height > 1)) {
+		levels[mip_count] = downsample(&levels[mip_count - 1], normal_map);
+		mip_count += 1;
+	}
+	
+	TextureFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = texture_file_magic;
+	header.version = texture_file_version;
+	header.header_size = sizeof(TextureFileHeader);
+	header.format = (uint32_t) format;
+	header.width = levels[0].width;
+	header.height = levels[0].height;
+	header.mip_count = mip_count;
+	
+	// Smallest level first, in the order the loader streams them in.
+	uint64_t offset = sizeof(TextureFileHeader);
+	for (int32_t level = mip_count - 1; level >= 0; level -= 1) {
+		offset = (offset + texture_file_alignment - 1) / texture_file_alignment * texture_file_alignment;
+		header.mips[level].offset = offset;
+		header.mips[level].size = level_size(format, &levels[level]);
+		offset += header.mips[level].size;
+	}
+	
+	uint8_t* file_data = (uint8_t*) calloc(1, (size_t) offset);
+	memcpy(file_data, &header, sizeof(header));
+	for (int32_t level = 0; level < mip_count; level += 1) {
+		encode_level(format, &levels[level], file_data + header.mips[level].offset);
+	}
+	
+	FILE* f = fopen(output_path, "wb");
+	if (!f || fwrite(file_data, 1, (size_t) offset, f) != offset) {
+		printf("Failed to write '%s'.\n", output_path);
+		return 1;
+	}
+	fclose(f);
+	
+	printf("%s: %dx%d, %d mips, %llu bytes.\n", output_path, header.width, header.height, mip_count, (unsigned long long) offset);
+	return 0;
+}
\ No newline at end of file
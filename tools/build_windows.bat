@@ -0,0 +1,24 @@
+@echo off
+setlocal enableDelayedExpansion
+
+rem Builds the offline tools. They only need the Paintbox header, not the library.
+
+set build_folder=.build
+
+where /q cl
+if errorlevel 1 (
+    echo Microsoft compiler tools are missing. 
+    echo Please run vcvarsall.bat or rerun the script from a developer console.
+    exit /b
+)
+
+if not exist !build_folder! (mkdir !build_folder!)
+
+for %%i in (*.cpp) do (
+	cl /nologo /O2 /I..\include /I..\examples\third_party %%~fi /Fo"!build_folder!\%%~ni.obj" /Fe"!build_folder!\%%~ni.exe"
+	if errorlevel 1 (
+		echo:
+		echo Compilation error! Stopping...
+		exit /b
+	)
+)